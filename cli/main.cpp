@@ -0,0 +1,510 @@
+// mindmap-cli：不依赖界面的命令行工具，在没有显示环境的服务器上批量处理思维导图目录。
+// 与图形界面共用存储后端、编辑日志、标签索引和连线表；多张图在线程池中并行处理。
+//
+//   mindmap-cli open     <图目录>...            回放未合并的编辑日志并报告概况
+//   mindmap-cli validate <图目录>...            检查文档、子节点列表、索引和连线
+//   mindmap-cli stats    <图目录>...            统计节点、层级、标签和连线
+//   mindmap-cli export   -o <文件|目录> <图目录>...   导出为单个 JSON 文件
+//   mindmap-cli import   <导出文件> <图目录>    由导出文件创建新图
+//   mindmap-cli convert  --to folder|packed <图目录>...  转换存储格式
+
+#include "MapStorage.h"
+#include "FolderStorage.h"
+#include "PackedStorage.h"
+#include "MapJournal.h"
+#include "TagIndex.h"
+#include "SearchIndex.h"
+#include "LinkTable.h"
+#include "DurableWriter.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QThread>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+const QString kExportFormat = QStringLiteral("mindmap-export");
+const int kExportVersion = 1;
+
+// 单张图的处理结果，在工作线程中生成，由主线程按输入顺序输出
+struct Report
+{
+    QStringList lines;
+    int errors = 0;
+    int warnings = 0;
+
+    void info(const QString& text) { lines.append(QStringLiteral("  ") + text); }
+    void warn(const QString& text) { lines.append(QStringLiteral("  警告: ") + text); ++warnings; }
+    void fail(const QString& text) { lines.append(QStringLiteral("  错误: ") + text); ++errors; }
+};
+
+QString relativePath(const QString& root, const QString& path)
+{
+    QString rel = QDir(root).relativeFilePath(path);
+    if (rel == ".") rel.clear();
+    return rel;
+}
+
+QString formatName(MapStorage::Format format)
+{
+    return format == MapStorage::PackedFormat ? QStringLiteral("packed") : QStringLiteral("folder");
+}
+
+// 读出整棵树，记录按先父后子排列
+bool loadMap(const QString& path, QSharedPointer<MapStorage>& storage, QList<NodeRecord>& records, Report& report)
+{
+    if (!QFileInfo(path).isDir()) {
+        report.fail("目录不存在");
+        return false;
+    }
+    storage = MapStorage::create(MapStorage::detect(path), path);
+    if (!storage->load(records) || records.isEmpty()) {
+        report.fail("无法读取节点");
+        return false;
+    }
+    return true;
+}
+
+void checkJournal(const QString& path, Report& report)
+{
+    MapJournal journal(path);
+    if (journal.needsRecovery()) {
+        report.warn(QString("编辑日志中有未合并的修改（%1 字节），用 open 命令合并")
+                    .arg(QFileInfo(journal.filePath()).size()));
+    }
+}
+
+Report openMap(const QString& path)
+{
+    Report report;
+    if (!QFileInfo(path).isDir()) {
+        report.fail("目录不存在");
+        return report;
+    }
+
+    // 与图形界面打开时相同：先把上次未正常关闭留下的日志回放到存储
+    QSharedPointer<MapStorage> storage = MapStorage::create(MapStorage::detect(path), path);
+    MapJournal journal(path);
+    if (journal.needsRecovery()) {
+        const int replayed = journal.replay(*storage);
+        if (replayed < 0) {
+            report.fail("编辑日志回放后无法写入，日志已保留");
+            return report;
+        }
+        report.info(QString("回放编辑日志 %1 条").arg(replayed));
+        // 回放改动了节点文档，保存的标签和搜索索引已过期
+        TagIndex tags;
+        tags.reset(path);
+        tags.discard();
+        SearchIndex search;
+        search.reset(path);
+        search.discard();
+    }
+
+    QList<NodeRecord> records;
+    if (!storage->load(records) || records.isEmpty()) {
+        report.fail("无法读取节点");
+        return report;
+    }
+    report.info(QString("格式 %1，%2 个节点").arg(formatName(storage->format())).arg(records.size()));
+    return report;
+}
+
+Report validateMap(const QString& path)
+{
+    Report report;
+    QSharedPointer<MapStorage> storage;
+    QList<NodeRecord> records;
+    if (!loadMap(path, storage, records, report)) return report;
+    checkJournal(path, report);
+
+    // 文档缺失或无法解析、缺少文字、子节点列表与实际文件夹不符
+    QHash<int, QSet<QString>> folders;   // 记录编号 -> 实际子文件夹名
+    QSet<QString> paths;
+    for (const NodeRecord& record : std::as_const(records)) {
+        paths.insert(relativePath(path, record.path));
+        if (record.parent >= 0) folders[record.parent].insert(record.name);
+    }
+    int emptyDocuments = 0;
+    int missingText = 0;
+    int staleChildren = 0;
+    for (const NodeRecord& record : std::as_const(records)) {
+        const QString rel = relativePath(path, record.path);
+        if (record.json.isEmpty()) {
+            if (++emptyDocuments <= 10) report.fail(QString("节点文档缺失或无法解析: /%1").arg(rel));
+            continue;
+        }
+        if (!record.json.contains("text")) ++missingText;
+
+        const QSet<QString> actual = folders.value(record.id);
+        for (const QJsonValue& child : record.json["children"].toArray()) {
+            const QString name = QDir::cleanPath(child.toString());
+            if (!name.isEmpty() && !name.contains('/') && !actual.contains(name)) {
+                if (++staleChildren <= 10) report.warn(QString("子节点列表中的 %1 不存在: /%2").arg(name, rel));
+            }
+        }
+    }
+    if (emptyDocuments > 10) report.fail(QString("另有 %1 个节点文档缺失或无法解析").arg(emptyDocuments - 10));
+    if (staleChildren > 10) report.warn(QString("另有 %1 处子节点列表过期").arg(staleChildren - 10));
+    if (missingText > 0) report.warn(QString("%1 个节点没有 text 字段，将显示文件夹名").arg(missingText));
+
+    // 连线两端都必须是存在的节点
+    LinkTable links;
+    links.reset(path);
+    if (QFile::exists(QDir(path).filePath(LinkTable::fileName()))) {
+        if (!links.load()) {
+            report.fail("连线表无法读取");
+        } else {
+            int dangling = 0;
+            for (const LinkTable::Link& link : links.links()) {
+                const QString source = relativePath(path, links.path(link.source));
+                const QString destination = relativePath(path, links.path(link.destination));
+                if (!paths.contains(source) || !paths.contains(destination)) ++dangling;
+            }
+            if (dangling > 0) report.fail(QString("%1 条连线指向不存在的节点").arg(dangling));
+        }
+    }
+
+    // 保存的标签索引应与文档一致，否则图形界面会给出过期的筛选结果
+    TagIndex saved;
+    saved.reset(path);
+    if (saved.load()) {
+        TagIndex fresh;
+        fresh.reset(path);
+        fresh.rebuild(records);
+        QStringList tags = fresh.tags();
+        for (const QString& tag : saved.tags()) {
+            if (!tags.contains(tag)) tags.append(tag);
+        }
+        for (const QString& tag : std::as_const(tags)) {
+            if (saved.count(tag) != fresh.count(tag)) {
+                report.warn(QString("标签索引已过期（%1），打开时会重建").arg(tag));
+                break;
+            }
+        }
+    }
+
+    report.info(QString("%1 个节点，%2 个错误，%3 个警告").arg(records.size()).arg(report.errors).arg(report.warnings));
+    return report;
+}
+
+Report mapStats(const QString& path)
+{
+    Report report;
+    QElapsedTimer timer;
+    timer.start();
+    QSharedPointer<MapStorage> storage;
+    QList<NodeRecord> records;
+    if (!loadMap(path, storage, records, report)) return report;
+    const qint64 loadTime = timer.elapsed();
+
+    // 记录按先父后子排列，深度和子节点数一遍即可算出
+    QVector<int> depth(records.size(), 0);
+    QVector<int> fanOut(records.size(), 0);
+    QHash<QString, int> tagCounts;
+    qint64 bytes = 0;
+    int tagged = 0;
+    for (const NodeRecord& record : std::as_const(records)) {
+        if (record.parent >= 0) {
+            depth[record.id] = depth[record.parent] + 1;
+            ++fanOut[record.parent];
+        }
+        const QJsonArray tags = record.json["tags"].toArray();
+        if (!tags.isEmpty()) ++tagged;
+        for (const QJsonValue& tag : tags) ++tagCounts[tag.toString()];
+        bytes += QJsonDocument(record.json).toJson(QJsonDocument::Compact).size();
+    }
+    const int maxDepth = *std::max_element(depth.cbegin(), depth.cend());
+    const auto widest = std::max_element(fanOut.cbegin(), fanOut.cend());
+    const int leaves = int(std::count(fanOut.cbegin(), fanOut.cend(), 0));
+
+    LinkTable links;
+    links.reset(path);
+    links.load();
+
+    report.info(QString("格式 %1，读取 %2 ms").arg(formatName(storage->format())).arg(loadTime));
+    report.info(QString("节点 %1，叶子 %2，最大深度 %3").arg(records.size()).arg(leaves).arg(maxDepth));
+    report.info(QString("最多子节点 %1: /%2").arg(*widest)
+                .arg(relativePath(path, records.at(int(widest - fanOut.cbegin())).path)));
+    report.info(QString("带标签节点 %1，不同标签 %2").arg(tagged).arg(tagCounts.size()));
+    report.info(QString("跨节点连线 %1").arg(links.size()));
+    report.info(QString("文档总大小 %1 KB").arg(bytes / 1024));
+    checkJournal(path, report);
+    return report;
+}
+
+// 导出为单个 JSON：节点以相对路径标识，按先父后子排列，连线是相对路径对
+Report exportMap(const QString& path, const QString& output)
+{
+    Report report;
+    QSharedPointer<MapStorage> storage;
+    QList<NodeRecord> records;
+    if (!loadMap(path, storage, records, report)) return report;
+    checkJournal(path, report);
+
+    QJsonArray nodes;
+    for (const NodeRecord& record : std::as_const(records)) {
+        QJsonObject doc = record.json;
+        doc.remove("path");   // 绝对路径在导入时按新位置重写
+        nodes.append(QJsonObject{ { "path", relativePath(path, record.path) }, { "doc", doc } });
+    }
+
+    QJsonArray linkArray;
+    LinkTable links;
+    links.reset(path);
+    if (links.load()) {
+        for (const LinkTable::Link& link : links.links()) {
+            linkArray.append(QJsonArray{ relativePath(path, links.path(link.source)),
+                                         relativePath(path, links.path(link.destination)) });
+        }
+    }
+
+    QJsonObject root;
+    root["format"] = kExportFormat;
+    root["version"] = kExportVersion;
+    root["name"] = QDir(path).dirName();
+    root["nodes"] = nodes;
+    root["links"] = linkArray;
+    if (!DurableWriter::writeFile(output, QJsonDocument(root).toJson(QJsonDocument::Compact), DurableWriter::Durable)) {
+        report.fail("无法写入 " + output);
+        return report;
+    }
+    report.info(QString("导出 %1 个节点、%2 条连线到 %3").arg(nodes.size()).arg(linkArray.size()).arg(output));
+    return report;
+}
+
+Report importMap(const QString& input, const QString& path, MapStorage::Format format)
+{
+    Report report;
+    QFile file(input);
+    if (!file.open(QIODevice::ReadOnly)) {
+        report.fail("无法读取 " + input);
+        return report;
+    }
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root["format"].toString() != kExportFormat || root["version"].toInt() != kExportVersion) {
+        report.fail("不是可识别的导出文件");
+        return report;
+    }
+
+    // 不覆盖已有的图
+    QDir dir(path);
+    if (QFile::exists(dir.filePath("node.json")) || QFile::exists(dir.filePath(PackedStorage::fileName()))) {
+        report.fail("目标目录中已有思维导图");
+        return report;
+    }
+    if (!dir.mkpath(".")) {
+        report.fail("无法创建目录");
+        return report;
+    }
+    const QString rootPath = dir.absolutePath();
+
+    // 文件夹层级先建好，节点文档作为一组提交
+    QHash<QString, QJsonObject> documents;
+    for (const QJsonValue& value : root["nodes"].toArray()) {
+        const QJsonObject node = value.toObject();
+        const QString rel = QDir::cleanPath(node["path"].toString());
+        if (rel.startsWith("..") || QDir::isAbsolutePath(rel)) {
+            report.warn("跳过越出根目录的节点: " + rel);
+            continue;
+        }
+        const QString folder = rel.isEmpty() || rel == "." ? rootPath : dir.filePath(rel);
+        if (!QDir().mkpath(folder)) {
+            report.fail("无法创建文件夹: " + folder);
+            return report;
+        }
+        QJsonObject doc = node["doc"].toObject();
+        doc["path"] = folder;
+        documents.insert(folder, doc);
+    }
+    QSharedPointer<MapStorage> storage = MapStorage::create(format, rootPath);
+    if (!storage->writeNodes(documents) || !storage->sync()) {
+        report.fail("无法写入节点文档");
+        return report;
+    }
+
+    LinkTable links;
+    links.reset(rootPath);
+    links.setComplete(true);
+    for (const QJsonValue& value : root["links"].toArray()) {
+        const QJsonArray pair = value.toArray();
+        links.add(dir.filePath(pair.at(0).toString()), dir.filePath(pair.at(1).toString()));
+    }
+    if (!links.isEmpty() && !links.save()) report.fail("无法写入连线表");
+
+    report.info(QString("导入 %1 个节点、%2 条连线，格式 %3").arg(documents.size()).arg(links.size())
+                .arg(formatName(format)));
+    return report;
+}
+
+Report convertMap(const QString& path, MapStorage::Format format)
+{
+    Report report;
+    if (!QFileInfo(path).isDir()) {
+        report.fail("目录不存在");
+        return report;
+    }
+    QSharedPointer<MapStorage> from = MapStorage::create(MapStorage::detect(path), path);
+    if (from->format() == format) {
+        report.info("已是 " + formatName(format) + " 格式");
+        return report;
+    }
+
+    // 先合并编辑日志，否则日志中的修改在新格式里丢失
+    MapJournal journal(path);
+    if (journal.needsRecovery()) {
+        const int replayed = journal.replay(*from);
+        if (replayed < 0) {
+            report.fail("编辑日志回放后无法写入，未转换");
+            return report;
+        }
+        report.info(QString("回放编辑日志 %1 条").arg(replayed));
+        // 与 open 相同：回放改动了节点文档，保存的标签和搜索索引已过期
+        TagIndex tags;
+        tags.reset(path);
+        tags.discard();
+        SearchIndex search;
+        search.reset(path);
+        search.discard();
+    }
+
+    QSharedPointer<MapStorage> to = MapStorage::create(format, path);
+    const int copied = MapStorage::copy(*from, *to);
+    if (copied < 0) {
+        report.fail("无法读取或写入节点");
+        return report;
+    }
+    // 与图形界面保存时相同：转回文件夹格式后移除打包文件
+    if (format == MapStorage::FolderFormat) {
+        QFile::remove(QDir(path).filePath(PackedStorage::fileName()));
+        QFile::remove(QDir(path).filePath(PackedStorage::logFileName()));
+    } else {
+        // 打包文件已完整写出，各文件夹中的 node.json 不再使用，留着会与打包内容分叉
+        QDirIterator it(path, { QStringLiteral("node.json") }, QDir::Files, QDirIterator::Subdirectories);
+        int removed = 0;
+        while (it.hasNext()) {
+            if (QFile::remove(it.next())) ++removed;
+            else report.warn("无法删除旧格式文件（打开时以打包文件为准）: " + it.filePath());
+        }
+        report.info(QString("删除文件夹格式的节点文档 %1 个").arg(removed));
+    }
+    report.info(QString("转换为 %1 格式，%2 个节点").arg(formatName(format)).arg(copied));
+    return report;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mindmap-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("思维导图目录的命令行批处理工具");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "open | validate | stats | export | import | convert");
+    parser.addPositionalArgument("maps", "思维导图根目录", "<图目录>...");
+    QCommandLineOption jobsOption({ "j", "jobs" }, "并行处理的图数量，默认为处理器核数", "n");
+    QCommandLineOption outputOption({ "o", "output" }, "export 的输出文件（单张图）或目录", "path");
+    QCommandLineOption toOption("to", "convert 的目标格式：folder 或 packed", "format");
+    QCommandLineOption formatOption("format", "import 创建的存储格式：folder 或 packed", "format", "folder");
+    parser.addOption(jobsOption);
+    parser.addOption(outputOption);
+    parser.addOption(toOption);
+    parser.addOption(formatOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QStringList args = parser.positionalArguments();
+    if (args.isEmpty()) parser.showHelp(2);
+    const QString command = args.takeFirst();
+
+    auto parseFormat = [&](const QString& name, MapStorage::Format& format) {
+        if (name == "folder") format = MapStorage::FolderFormat;
+        else if (name == "packed") format = MapStorage::PackedFormat;
+        else return false;
+        return true;
+    };
+
+    // 每张图一个任务
+    std::function<Report(const QString&)> task;
+    if (command == "open") {
+        task = openMap;
+    } else if (command == "validate") {
+        task = validateMap;
+    } else if (command == "stats") {
+        task = mapStats;
+    } else if (command == "export") {
+        if (!parser.isSet(outputOption)) {
+            err << "export 需要 --output" << Qt::endl;
+            return 2;
+        }
+        const QString output = parser.value(outputOption);
+        const bool toFile = args.size() == 1 && output.endsWith(".json", Qt::CaseInsensitive);
+        if (!toFile && !QDir().mkpath(output)) {
+            err << "无法创建输出目录: " << output << Qt::endl;
+            return 2;
+        }
+        task = [output, toFile](const QString& path) {
+            const QString name = QDir(QDir(path).absolutePath()).dirName() + ".json";
+            return exportMap(path, toFile ? output : QDir(output).filePath(name));
+        };
+    } else if (command == "import") {
+        MapStorage::Format format;
+        if (args.size() != 2 || !parseFormat(parser.value(formatOption), format)) {
+            err << "用法: mindmap-cli import [--format folder|packed] <导出文件> <图目录>" << Qt::endl;
+            return 2;
+        }
+        const Report report = importMap(args.at(0), args.at(1), format);
+        out << args.at(1) << Qt::endl;
+        for (const QString& line : report.lines) out << line << Qt::endl;
+        return report.errors > 0 ? 1 : 0;
+    } else if (command == "convert") {
+        MapStorage::Format format;
+        if (!parseFormat(parser.value(toOption), format)) {
+            err << "convert 需要 --to folder 或 --to packed" << Qt::endl;
+            return 2;
+        }
+        task = [format](const QString& path) { return convertMap(path, format); };
+    } else {
+        err << "未知命令: " << command << Qt::endl;
+        parser.showHelp(2);
+    }
+    if (args.isEmpty()) {
+        err << "缺少图目录" << Qt::endl;
+        return 2;
+    }
+
+    // 各张图互不相关，在线程池中并行处理，结果按输入顺序输出
+    QThreadPool pool;
+    const int jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt() : QThread::idealThreadCount();
+    pool.setMaxThreadCount(qMax(1, jobs));
+    QVector<Report> reports(args.size());
+    for (int i = 0; i < args.size(); ++i) {
+        pool.start([&reports, &task, &args, i]() { reports[i] = task(args.at(i)); });
+    }
+    pool.waitForDone();
+
+    int failed = 0;
+    for (int i = 0; i < args.size(); ++i) {
+        out << args.at(i) << Qt::endl;
+        for (const QString& line : std::as_const(reports[i].lines)) out << line << Qt::endl;
+        if (reports[i].errors > 0) ++failed;
+    }
+    if (args.size() > 1) out << QString("共 %1 张图，%2 张有错误").arg(args.size()).arg(failed) << Qt::endl;
+    return failed > 0 ? 1 : 0;
+}
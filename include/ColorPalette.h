@@ -0,0 +1,16 @@
+#ifndef COLORPALETTE_H
+#define COLORPALETTE_H
+
+#include <QColor>
+
+// 节点颜色调色板：整张图只用到少数几种颜色，节点只保存调色板下标。
+// 下标 0 固定为默认节点颜色。只在GUI线程使用。
+class ColorPalette
+{
+public:
+    static quint16 index(const QColor& color);
+    static QColor color(quint16 index);
+    static int size();
+};
+
+#endif // COLORPALETTE_H
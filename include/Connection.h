@@ -8,13 +8,22 @@ class Connection : public QGraphicsPathItem
 {
 public:
     Connection(MindMapNode* source, MindMapNode* destination, QGraphicsItem* parent = nullptr);
+    ~Connection();
 
     void updatePath();
 
     MindMapNode* sourceNode() const { return m_source; }
     MindMapNode* destinationNode() const { return m_destination; }
+    // 端点节点析构时调用，之后不再访问该节点
+    void detach(MindMapNode* node);
+
+    // 回收池使用：reset 从两端移除并清空路径，rebind 连到新的端点
+    void reset();
+    void rebind(MindMapNode* source, MindMapNode* destination);
 
 private:
+    void unregister();
+
     MindMapNode* m_source;
     MindMapNode* m_destination;
 };
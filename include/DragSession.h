@@ -0,0 +1,52 @@
+#ifndef DRAGSESSION_H
+#define DRAGSESSION_H
+
+#include <QObject>
+#include <QVector>
+#include <QSet>
+#include <QPointF>
+#include <QTimer>
+
+class MindMapScene;
+class MindMapNode;
+class Connection;
+
+// 拖动会话：鼠标拖动节点期间，位置变化不逐次更新连线和保存。
+// 子树随根节点整体平移，连线按显示帧率更新：两端都在拖动集合内的只做平移，
+// 跨出集合的才重算路径；松开鼠标时每个被拖动的节点只保存一次位置。
+class DragSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DragSession(MindMapScene* scene);
+
+    void press(MindMapNode* node);     // 左键按下，尚未移动
+    void release();                    // 松开鼠标，结束会话并保存
+    bool isActive() const { return !m_roots.isEmpty(); }
+    // 节点位置变化时调用，返回 false 表示不属于拖动，按普通移动处理
+    bool nodeMoved(MindMapNode* node);
+    void nodeRemoved(MindMapNode* node);
+
+private:
+    struct Root
+    {
+        MindMapNode* node;
+        QPointF anchor;   // 上次整理集合时的场景坐标
+    };
+
+    void collect();       // 整理拖动集合及受影响的连线
+    void addSubtree(MindMapNode* node);
+    void applyFrame();
+    QPointF offset() const;
+
+    MindMapScene* m_scene;
+    MindMapNode* m_pressed;
+    QVector<Root> m_roots;
+    QSet<const MindMapNode*> m_moving;         // 拖动根节点及其全部已加载后代
+    QVector<Connection*> m_crossing;           // 一端在集合外，每帧重算
+    QVector<QPair<Connection*, QPointF>> m_carried; // 两端都在集合内的顶层连线，只平移
+    QTimer m_frameTimer;
+    bool m_stale;
+};
+
+#endif // DRAGSESSION_H
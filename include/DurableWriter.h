@@ -0,0 +1,49 @@
+#ifndef DURABLEWRITER_H
+#define DURABLEWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+
+// 成组提交的文件写入：一批文件先各自写到同目录下的临时文件，
+// 全部刷盘后再逐个改名替换原文件，最后每个目录刷一次目录项。
+// Linux 上每个临时文件写完就开始回写，逐个刷盘时多半只是等待已在进行的写入。
+class DurableWriter
+{
+public:
+    enum Durability {
+        Buffered,   // 直接覆盖写，交给系统缓冲；写到一半崩溃会留下残缺文件
+        Atomic,     // 临时文件改名替换，文件不会残缺，断电可能丢失最近一批
+        Durable     // 改名前后都刷盘，commit 返回时整批已持久化
+    };
+
+    explicit DurableWriter(Durability durability = Durable);
+    ~DurableWriter();
+
+    void add(const QString& filePath, const QByteArray& data);
+    int pending() const { return m_files.size(); }
+    // 写出本批并清空。临时文件写入或刷盘失败则整批放弃，原文件都不动；
+    // 改名阶段失败时返回 false，此时部分文件可能已替换，调用方应重试整批
+    bool commit();
+
+    // 单个文件的便捷写法
+    static bool writeFile(const QString& filePath, const QByteArray& data, Durability durability);
+    // 把目录中的改名、新建等目录项变化刷到磁盘
+    static bool syncDirectory(const QString& dirPath);
+    // 与 filePath 同目录的临时文件名，改名替换时使用
+    static QString tempPath(const QString& filePath);
+    // 删除目录树中上次崩溃留下的临时文件，返回删除的个数
+    static int removeStaleTemps(const QString& rootPath);
+
+private:
+    bool writeDirect();
+    // 刷写文件内容（files）或目录项（dirs）
+    bool syncGroup(const QStringList& files, const QStringList& dirs);
+
+    QVector<QPair<QString, QByteArray>> m_files;
+    Durability m_durability;
+};
+
+#endif // DURABLEWRITER_H
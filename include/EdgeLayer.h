@@ -0,0 +1,108 @@
+#ifndef EDGELAYER_H
+#define EDGELAYER_H
+
+#include <QGraphicsObject>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPainterPath>
+#include <QPen>
+#include <QTimer>
+
+class MindMapNode;
+class MapModel;
+class Connection;
+
+// 合并绘制的连线层：整张图的父子连线和跨节点连线存放在一个连续数组里，
+// 按网格索引裁剪到暴露区域后一次绘制，代替每条连线一个图形项。
+// 父子连线按子节点、跨节点连线按连线对象登记下标：节点移动、增删或展开折叠后
+// 只同步该节点子树上的连线，并把它们移出旧的网格单元、放进新的单元；
+// 打开图、批量更新结束或虚拟化时才整体重建。
+class EdgeLayer : public QGraphicsObject
+{
+    Q_OBJECT
+public:
+    explicit EdgeLayer(QGraphicsItem* parent = nullptr);
+
+    QRectF boundingRect() const override;
+    QPainterPath shape() const override;   // 不参与点击检测
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
+
+    void markDirty();   // 合并到下一轮事件整体重建
+    // 虚拟化显示时连线取自模型，不依赖图形项；传空指针恢复按节点收集
+    void setModel(const MapModel* model) { m_model = model; }
+    void rebuild();
+
+    // 节点移动、新增或展开折叠：合并到下一轮事件同步其子树上的连线
+    void nodeChanged(const MindMapNode* node);
+    // 节点即将析构或离开场景：立即移除与它有关的连线，之后不再访问该指针
+    void nodeRemoved(const MindMapNode* node);
+    // 单条跨节点连线的端点移动或新建 / 即将删除
+    void linkChanged(const Connection* connection);
+    void linkRemoved(const Connection* connection);
+
+    // 拖动期间集合内的连线单独存放：内部连线合成一条路径整体平移，
+    // 跨出集合的连线按偏移重算端点，其余连线不动
+    void beginDrag(const QSet<const MindMapNode*>& moving);
+    void dragTo(const QPointF& offset);
+    void endDrag();
+    int edgeCount() const { return m_edges.size() - m_free.size(); }
+
+    enum { Type = UserType + 2 };
+    int type() const override { return Type; }
+
+private:
+    struct Edge
+    {
+        QPointF from;
+        QPointF to;
+        QRectF bounds;
+        int moving = 0;   // 拖动中：1 起点在集合内，2 终点在集合内
+        bool live = true; // 已删除的下标留在空闲列表中复用
+    };
+
+    void collectEdges(MindMapNode* node);
+    void collectModelEdges();
+    int addEdge(const QPointF& from, const QPointF& to, int moving = 0);
+    void refresh();
+    bool isShown(const MindMapNode* node) const;
+    void syncSubtree(const MindMapNode* node, bool shown);
+    void syncTreeEdge(const MindMapNode* node, bool shown);
+    void syncLink(const Connection* connection);
+    int placeEdge(int index, const QPointF& from, const QPointF& to);
+    void releaseEdge(int index);
+    void insertCells(int index);
+    void removeCells(int index);
+    void holdForDrag(int index, int moving);
+    void finishEdits();
+    void updateBounds();
+    QPointF dragDelta() const { return m_dragOffset - m_dragBase; }
+    void collectVisible(const QRectF& exposed, QVector<int>& visible);
+
+    QVector<Edge> m_edges;
+    QVector<int> m_free;                   // 已删除连线空出的下标
+    QHash<const MindMapNode*, int> m_treeEdges;  // 子节点 -> 连向父节点的连线下标
+    QHash<const Connection*, int> m_linkEdges;   // 跨节点连线 -> 连线下标
+    QSet<const MindMapNode*> m_pending;    // 待同步连线的子树根
+    bool m_rebuildAll;                     // 下一轮整体重建
+    QRectF m_damage;                       // 本轮同步改动过的区域
+    QHash<quint64, QVector<int>> m_grid;   // 网格单元 -> 连线下标
+    QVector<int> m_large;                  // 跨越单元过多的长连线，逐条检测
+    QVector<int> m_stamp;                  // 去重用，记录连线最近一次被收集的帧号
+    int m_frame;
+    QRectF m_bounds;
+    QRectF m_staticBounds;                 // 不随拖动变化的连线包围盒
+
+    QSet<const MindMapNode*> m_dragSet;
+    QPainterPath m_dragPath;               // 两端都在集合内的连线，开始拖动时的位置
+    QVector<int> m_dragInside;             // 两端都在集合内的连线下标
+    QVector<int> m_dragCrossing;           // 一端在集合内的连线下标
+    QRectF m_dragExtent;                   // 拖动中连线当前覆盖的区域
+    QPointF m_dragOffset;                  // 会话给出的当前偏移
+    QPointF m_dragBase;                    // 拖动路径建立时的偏移
+    QPen m_pen;
+    QTimer m_rebuildTimer;
+    const MapModel* m_model;
+};
+
+#endif // EDGELAYER_H
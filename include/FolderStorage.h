@@ -0,0 +1,28 @@
+#ifndef FOLDERSTORAGE_H
+#define FOLDERSTORAGE_H
+
+#include "MapStorage.h"
+
+// 默认后端：每个节点文件夹下一个 node.json
+// 一批文档作为一组提交：临时文件、一次成组刷盘、原子改名
+class FolderStorage : public MapStorage
+{
+public:
+    explicit FolderStorage(const QString& rootPath);
+
+    Format format() const override { return FolderFormat; }
+
+    bool load(QList<NodeRecord>& records) override;
+    QJsonObject readNode(const QString& folderPath) const override;
+    QStringList childNames(const QString& folderPath) const override;
+    bool writeNodes(const QHash<QString, QJsonObject>& documents) override;
+
+    static QJsonObject readFile(const QString& folderPath);
+    static bool writeFile(const QString& folderPath, const QJsonObject& json,
+                          DurableWriter::Durability durability = DurableWriter::Durable);
+
+private:
+    void loadSubtree(int parentIndex, QList<NodeRecord>& records);
+};
+
+#endif // FOLDERSTORAGE_H
@@ -0,0 +1,43 @@
+#ifndef ITEMPOOL_H
+#define ITEMPOOL_H
+
+#include <QVector>
+#include "NodeRecord.h"
+
+class QGraphicsItem;
+class QGraphicsScene;
+class MindMapNode;
+class Connection;
+
+// 节点和连线图形项的回收池：折叠释放、删除节点时图形项移出场景放回池中，
+// 再次展开或加载时换绑到新记录，不重新分配。池中的图形项保留各自容器
+// 已分配的容量，反复展开折叠大分支时不再频繁申请、释放小块内存。
+class ItemPool
+{
+public:
+    explicit ItemPool(int limit = 4096);
+    ~ItemPool();
+
+    // 取出一个节点并换绑到 record；parent 为空时由调用方加入场景
+    MindMapNode* takeNode(const NodeRecord& record, QGraphicsItem* parent);
+    Connection* takeConnection(MindMapNode* source, MindMapNode* destination, QGraphicsItem* parent);
+
+    // 回收前节点须已没有子节点和连线；池满时直接删除
+    void recycle(MindMapNode* node);
+    void recycle(Connection* connection);
+
+    void setLimit(int limit);
+    int limit() const { return m_limit; }
+    int nodeCount() const { return m_nodes.size(); }
+    int connectionCount() const { return m_connections.size(); }
+    void clear();
+
+private:
+    static void detach(QGraphicsItem* item);
+
+    QVector<MindMapNode*> m_nodes;
+    QVector<Connection*> m_connections;
+    int m_limit;   // 每种图形项最多保留的数量
+};
+
+#endif // ITEMPOOL_H
@@ -0,0 +1,51 @@
+#ifndef LAYOUTENGINE_H
+#define LAYOUTENGINE_H
+
+#include <QHash>
+#include <QSet>
+#include "LayoutSnapshot.h"
+
+class MindMapNode;
+
+// 增量大纲布局：子节点相对父节点缩进一级，每个可见节点占一行。
+// 缓存每棵子树占用的行数；某个节点的子树变化时只重排它的直接子节点，
+// 再沿祖先链把其后的兄弟子树整体平移（子项随父项移动，无需逐个设置）。
+// 紧凑树布局没有增量路径，变化后做一次线性时间的全量布局。
+class LayoutEngine
+{
+public:
+    static constexpr qreal kIndent = 200;    // 水平缩进
+    static constexpr qreal kRowHeight = 80;  // 垂直间距
+
+    void setMode(LayoutMode mode);
+    LayoutMode mode() const { return m_mode; }
+
+    // 全量布局：拍快照、计算、回写，在当前线程完成
+    void layoutAll(MindMapNode* root);
+    // 全量布局拆成三步，计算一步可放到工作线程
+    LayoutSnapshot snapshot(MindMapNode* root) const;
+    static void compute(LayoutSnapshot& snapshot);
+    void apply(const LayoutSnapshot& snapshot);   // 批量回写位置并重建缓存
+
+    // 节点的子树结构变化（增删子节点、展开/折叠）
+    void invalidate(MindMapNode* node);
+    // 处理所有失效节点；失效过多时返回 false，由调用方改做全量布局
+    bool update(MindMapNode* root);
+    bool hasPending() const { return !m_dirty.isEmpty(); }
+
+    void forget(MindMapNode* node);
+    void clear();
+
+private:
+    int layoutSubtree(MindMapNode* node);
+    int placeChildren(MindMapNode* node);
+    void propagate(MindMapNode* node, int delta);
+    static void place(MindMapNode* node, qreal x, qreal y);
+    static int depth(const MindMapNode* node);
+
+    QHash<MindMapNode*, int> m_rows;   // 子树占用的行数
+    QSet<MindMapNode*> m_dirty;
+    LayoutMode m_mode = OutlineLayout;
+};
+
+#endif // LAYOUTENGINE_H
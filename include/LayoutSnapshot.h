@@ -0,0 +1,40 @@
+#ifndef LAYOUTSNAPSHOT_H
+#define LAYOUTSNAPSHOT_H
+
+#include <QVector>
+#include <QPointF>
+
+class MindMapNode;
+
+// 布局方式
+enum LayoutMode
+{
+    OutlineLayout,   // 大纲：逐行缩进
+    TidyLayout,      // 紧凑树：根在左，子树向右展开
+    BalancedLayout   // 紧凑树，根的子树分到左右两侧
+};
+
+// 布局用的扁平树快照（结构数组）：按先序排列，父项总在子项之前。
+// 工作线程只读写数组，不接触图形项；nodes 仅供GUI线程回写位置。
+// 由 MapModel 拍的快照没有图形项，source 记录对应的模型下标。
+struct LayoutSnapshot
+{
+    QVector<MindMapNode*> nodes;
+    QVector<int> source;
+    QVector<int> parent;        // 父节点下标，根为 -1
+    QVector<int> firstChild;    // 第一个可见子节点，无则为 -1
+    QVector<int> nextSibling;   // 下一个兄弟节点，无则为 -1
+    QVector<float> width;       // 节点包围盒尺寸
+    QVector<float> height;
+
+    // 计算结果
+    QVector<int> rows;          // 子树占用的行数
+    QVector<QPointF> pos;       // 相对父节点的位置
+
+    LayoutMode mode = OutlineLayout;
+    int generation = 0;         // 拍快照时场景结构的版本
+
+    int size() const { return parent.size(); }
+};
+
+#endif // LAYOUTSNAPSHOT_H
@@ -0,0 +1,30 @@
+#ifndef LAYOUTWORKER_H
+#define LAYOUTWORKER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include "LayoutSnapshot.h"
+
+// 在后台线程计算全量布局，结果在GUI线程一次性交回。
+// 新的请求会作废尚未交回的旧结果。
+class LayoutWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LayoutWorker(QObject* parent = nullptr);
+    ~LayoutWorker();
+
+    void start(const LayoutSnapshot& snapshot);
+    void abort();   // 丢弃正在计算的结果，不再发出信号
+    bool isRunning() const { return m_running; }
+
+signals:
+    void finished(const LayoutSnapshot& snapshot);
+
+private:
+    QThreadPool m_pool;
+    int m_ticket;   // 最近一次请求的编号
+    bool m_running;
+};
+
+#endif // LAYOUTWORKER_H
@@ -0,0 +1,83 @@
+#ifndef LINKTABLE_H
+#define LINKTABLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+#include "NodeRecord.h"
+#include "SymbolTable.h"
+
+// 整张图的跨节点连线表（父子关系之外的连线）：节点以相对根目录的路径编号，
+// 连线是 (起点编号, 终点编号) 的连续数组。出边和入边按 CSR 方式存放：
+// 各节点的连线下标连续排列，另有一个偏移数组，需要时一次计数排序重建。
+// 整张表保存为根目录下的一个文件，打开时整体读入，保存时整体写出。
+//
+// 文件布局（QDataStream）：
+//   "MMLK" | 版本 u32 | 节点路径表 | 连线数 | [起点 u32, 终点 u32]...
+class LinkTable
+{
+public:
+    struct Link
+    {
+        quint32 source;
+        quint32 destination;
+    };
+
+    static QString fileName() { return QStringLiteral("links.index"); }
+
+    void reset(const QString& rootPath);   // 切换到另一张图，清空内容
+    bool load();                           // 读入已保存的连线表，失败时保持为空
+    bool save();                           // 只在有修改时写出
+    // 由全部节点记录重建：导入旧版本写在节点文档 "connections" 中的连线
+    void rebuild(const QList<NodeRecord>& records);
+    void addRecord(const NodeRecord& record);
+
+    bool isComplete() const { return m_complete; }
+    void setComplete(bool complete) { m_complete = complete; }
+    bool isEmpty() const { return m_links.isEmpty(); }
+    int size() const { return m_links.size(); }
+
+    bool add(const QString& sourcePath, const QString& destinationPath);      // 已存在时返回 false
+    bool remove(const QString& sourcePath, const QString& destinationPath);
+    // 删除一端在该子树中的全部连线
+    void removeTree(const QString& folderPath);
+
+    // 按编号批量访问，供整张图一次性恢复连线
+    const QVector<Link>& links() const { return m_links; }
+    int nodeCount() const { return m_nodes.size(); }
+    QString path(int id) const { return absolutePath(m_nodes.name(id)); }
+    int nodeId(const QString& folderPath) const { return m_nodes.find(relativePath(folderPath)); }
+
+    // 与节点相连的连线下标
+    QVector<int> outgoing(int id) const;
+    QVector<int> incoming(int id) const;
+
+private:
+    static quint64 key(quint32 source, quint32 destination)
+    {
+        return (quint64(source) << 32) | destination;
+    }
+    QString relativePath(const QString& folderPath) const;
+    QString absolutePath(const QString& rel) const;
+    void insert(quint32 source, quint32 destination);
+    void removeAt(int index);
+    void buildAdjacency() const;
+
+    QString m_rootPath;
+    SymbolTable m_nodes;            // 相对路径 <-> 节点编号
+    QVector<Link> m_links;          // 删除时与末尾交换，顺序无意义
+    QSet<quint64> m_keys;           // 去重
+
+    // CSR 邻接：第 i 个节点的出边为 m_outLinks[m_outStart[i] .. m_outStart[i + 1])
+    mutable QVector<int> m_outStart;
+    mutable QVector<int> m_outLinks;
+    mutable QVector<int> m_inStart;
+    mutable QVector<int> m_inLinks;
+    mutable bool m_adjacencyValid = false;
+
+    bool m_complete = false;   // 是否覆盖了整张图
+    bool m_modified = false;
+};
+
+#endif // LINKTABLE_H
@@ -0,0 +1,45 @@
+#ifndef MAPJOURNAL_H
+#define MAPJOURNAL_H
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <QJsonValue>
+
+class MapStorage;
+
+// 整张图的追加式编辑日志：每次修改追加一行 JSON 操作记录，
+// 延迟写入队列把节点写回存储后截掉已落盘的部分。
+// 打开时日志非空说明上次没有正常关闭，先回放再加载。
+//
+// 记录格式：{"op": 操作, "node": 相对根目录的路径, "value": 值}
+class MapJournal
+{
+public:
+    explicit MapJournal(const QString& rootPath);
+    ~MapJournal();
+
+    static QString fileName() { return QStringLiteral("mindmap.journal"); }
+    QString filePath() const;
+
+    // 上次会话是否留下了未合并的记录
+    bool needsRecovery() const;
+    // 把日志回放到存储并清空，返回回放的记录数；写入失败时保留日志并返回 -1
+    int replay(MapStorage& storage);
+
+    bool open();
+    void append(const QString& op, const QString& folderPath, const QJsonValue& value);
+    qint64 size() const;
+    // 把已追加的记录刷到磁盘
+    void sync();
+    // 丢弃 checkpoint 之前的记录（它们已写入节点文件）；其后的记录经临时文件持久写回后再替换日志
+    void compact(qint64 checkpoint);
+
+private:
+    QString m_rootPath;
+    mutable QMutex m_mutex;
+    QFile m_file;
+    qint64 m_base; // 已从文件头部丢弃的字节数
+};
+
+#endif // MAPJOURNAL_H
@@ -0,0 +1,79 @@
+#ifndef MAPLOADER_H
+#define MAPLOADER_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QTimer>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <atomic>
+#include "MapStorage.h"
+#include "TagIndex.h"
+#include "SearchIndex.h"
+#include "LinkTable.h"
+
+// 后台建好的索引，只有对应的 has* 为真的才是新建的
+struct MapIndexes
+{
+    TagIndex tags;
+    SearchIndex search;
+    LinkTable links;   // 从节点文档导入的旧版本连线
+    bool hasTags = false;
+    bool hasSearch = false;
+    bool hasLinks = false;
+};
+
+// 异步加载器：目录扫描和 JSON 解析分散到线程池中并行执行，
+// 解析好的记录在GUI线程按批次交给场景，父记录总在子记录之前送达。
+// 中止时不等待后台任务：每次加载的状态单独存放，旧任务只改动自己那一份，结果随之丢弃。
+class MapLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MapLoader(QObject* parent = nullptr);
+    ~MapLoader();
+
+    // lazy 为真时不进入折叠节点的子树，只加载可见部分
+    void start(const QSharedPointer<MapStorage>& storage, bool lazy);
+    void cancel();   // 请求取消，随后发出 finished(false)
+    void abort();    // 立即停止，不再发出任何信号，也不等待进行中的任务
+    // 按需加载打开后，在后台读出全部文档建立缺少的索引和连线表，完成后发出 indexesReady
+    void buildIndexes(const QSharedPointer<MapStorage>& storage, bool tags, bool search, bool links);
+    bool isRunning() const { return m_running; }
+    bool isCanceled() const { return m_run && m_run->canceled; }
+
+signals:
+    void recordsReady(const QList<NodeRecord>& records);
+    void progress(int loaded);
+    void finished(bool ok);
+    void indexesReady(const QSharedPointer<MapIndexes>& indexes);
+
+private:
+    // 一次加载的状态，由这次加载的全部任务共享
+    struct Run
+    {
+        QMutex mutex;
+        QList<NodeRecord> pending;   // 已解析、尚未交给场景的记录
+        QAtomicInt nextId;
+        QAtomicInt activeTasks;
+        std::atomic<bool> canceled{ false };
+        std::atomic<bool> failed{ false };
+        bool lazy = false;
+    };
+
+    void scanFolder(const QSharedPointer<Run>& run, int id, int parentId, const QString& name, const QString& path);
+    void loadAll(const QSharedPointer<Run>& run, const QSharedPointer<MapStorage>& storage);
+    void drain();
+
+    QThreadPool m_pool;   // 析构时才等待其中的任务结束
+    QTimer m_drainTimer;
+
+    QSharedPointer<Run> m_run;       // 当前加载，中止后置空
+    QAtomicInt m_generation;         // abort 时递增，作废进行中的索引任务
+    bool m_running;
+    int m_delivered;
+};
+
+#endif // MAPLOADER_H
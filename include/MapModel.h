@@ -0,0 +1,82 @@
+#ifndef MAPMODEL_H
+#define MAPMODEL_H
+
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <QPointF>
+#include <QRectF>
+#include <QList>
+#include <QJsonObject>
+#include "NodeRecord.h"
+#include "LayoutSnapshot.h"
+
+class QFontMetrics;
+
+// 虚拟化显示用的轻量树模型：整张图只保存结构、文字、颜色、标签、展开状态和布局位置，
+// 不持有图形项。视口附近的节点才由 ViewportVirtualizer 创建图形项，
+// 所需的文档由模型生成，滚动时不读存储。
+class MapModel
+{
+public:
+    MapModel();
+
+    void clear();
+    // 父记录须先于子记录加入
+    void append(const NodeRecord& record);
+    // 全部记录到齐后排序兄弟节点、建立链接并测量节点尺寸
+    void finish();
+
+    int size() const { return m_parent.size(); }
+    int parent(int index) const { return m_parent[index]; }
+    int firstChild(int index) const { return m_firstChild[index]; }
+    int nextSibling(int index) const { return m_nextSibling[index]; }
+    QString name(int index) const { return m_name[index]; }
+    QString text(int index) const { return m_text[index]; }
+    void setText(int index, const QString& text);
+    QString folderPath(int index) const;
+    int find(const QString& folderPath) const;   // 不存在时返回 -1
+
+    // 由模型数据生成节点记录，供图形项换绑
+    NodeRecord record(int index) const;
+    // 图形项回收前把它的最新文档记回模型
+    void store(int index, const QJsonObject& json);
+
+    bool isExpanded(int index) const { return m_expanded[index]; }
+    void setExpanded(int index, bool expanded);
+    void setAllExpanded(bool expanded);
+    bool isVisible(int index) const { return m_visible[index]; }  // 所有祖先都已展开
+    QPointF position(int index) const { return m_pos[index]; }     // 场景坐标
+
+    int version() const { return m_version; }  // 文字、展开状态变化时递增
+
+    // 可见部分的布局快照，source 记录模型下标
+    LayoutSnapshot snapshot(LayoutMode mode) const;
+    void applyLayout(const LayoutSnapshot& snapshot);
+    // 区域内的可见节点
+    QVector<int> query(const QRectF& rect) const;
+
+private:
+    void measure(int index, const QFontMetrics& fm);
+
+    QVector<int> m_parent;
+    QVector<int> m_firstChild;
+    QVector<int> m_nextSibling;
+    QVector<QString> m_name;
+    QVector<QString> m_text;
+    QVector<quint16> m_color;             // 调色板下标
+    QHash<int, QList<quint32>> m_tags;    // 标签编号，只记带标签的节点
+    QHash<int, QJsonObject> m_extra;      // 文档中的其余字段，只记有这类字段的节点
+    QVector<float> m_width;
+    QVector<float> m_height;
+    QVector<bool> m_expanded;
+    QVector<bool> m_visible;
+    QVector<QPointF> m_pos;
+    QString m_rootPath;
+
+    QHash<int, int> m_recordIndex;        // 加载期间：记录编号 -> 下标
+    QHash<quint64, QVector<int>> m_grid;  // 网格单元 -> 可见节点
+    int m_version;
+};
+
+#endif // MAPMODEL_H
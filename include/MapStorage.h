@@ -0,0 +1,69 @@
+#ifndef MAPSTORAGE_H
+#define MAPSTORAGE_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include "NodeRecord.h"
+#include "DurableWriter.h"
+
+// 思维导图存储后端：每个文件夹一个 node.json，或整张图一个打包文件。
+// 两种后端都保持文件夹层级，节点以文件夹绝对路径标识。
+class MapStorage
+{
+public:
+    enum Format {
+        FolderFormat,   // 每个文件夹一个 node.json
+        PackedFormat    // 根目录下单个 CBOR 打包文件
+    };
+
+    virtual ~MapStorage() = default;
+
+    virtual Format format() const = 0;
+    QString rootPath() const { return m_rootPath; }
+
+    // 加载整棵树，记录按先父后子的顺序排列
+    virtual bool load(QList<NodeRecord>& records) = 0;
+    // 读取单个节点文档
+    virtual QJsonObject readNode(const QString& folderPath) const = 0;
+    // 列出直接子节点的文件夹名
+    virtual QStringList childNames(const QString& folderPath) const = 0;
+    // 写入一批节点文档（文件夹绝对路径 -> 文档），可在后台线程调用。
+    // 返回 false 时这批文档可能只写入了一部分，调用方应保留编辑日志并重试整批
+    virtual bool writeNodes(const QHash<QString, QJsonObject>& documents) = 0;
+    // 删除以该文件夹为根的子树（文件夹本身由调用方删除）
+    virtual void removeTree(const QString& folderPath) { Q_UNUSED(folderPath); }
+    // 把缓冲的修改持久化，失败时返回 false
+    virtual bool sync() { return true; }
+    // 持久化并整理为紧凑形式，开销可能与整张图成正比，只在保存和关闭时调用
+    virtual bool compact() { return sync(); }
+
+    // 写入的持久化程度；在写入线程空闲时设置
+    void setDurability(DurableWriter::Durability durability) { m_durability = durability; }
+    DurableWriter::Durability durability() const { return m_durability; }
+
+    // 按需加载：单个节点及其直接子节点的记录（不设置编号）
+    NodeRecord loadNode(const QString& folderPath) const;
+    QList<NodeRecord> loadChildren(const QString& folderPath) const;
+
+    // 文档的内容散列，与后端的文件格式无关；用于跳过内容没有变化的写入
+    static quint64 contentHash(const QJsonObject& json);
+
+    // 把 from 中的全部节点复制到 to（用于格式转换），返回节点数，读取或写入失败时返回 -1
+    static int copy(MapStorage& from, MapStorage& to);
+
+    // 根据根目录下是否存在打包文件选择后端
+    static Format detect(const QString& rootPath);
+    static QSharedPointer<MapStorage> create(Format format, const QString& rootPath);
+
+protected:
+    explicit MapStorage(const QString& rootPath) : m_rootPath(rootPath), m_durability(DurableWriter::Durable) {}
+
+    QString m_rootPath;
+    DurableWriter::Durability m_durability;
+};
+
+#endif // MAPSTORAGE_H
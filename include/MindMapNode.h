@@ -4,31 +4,54 @@
 #include <QGraphicsItem>
 #include <QColor>
 #include <QList>
+#include <QHash>
+#include <QStringList>
 #include <QStyleOption>
 #include <QDir>
 #include <QPainterPath>
 #include <QJsonObject>
+#include <QSharedPointer>
+#include <QStaticText>
+#include <QFont>
+#include "NodeRecord.h"
+#include "MapStorage.h"
 
 class Connection;
+class SaveQueue;
+class MindMapScene;
 
 class MindMapNode : public QGraphicsItem
 {
 public:
     explicit MindMapNode(const QString& text, const QString& path, QGraphicsItem* parent = nullptr);
+    // 由存储后端读出的记录构造，不访问磁盘
+    explicit MindMapNode(const NodeRecord& record, QGraphicsItem* parent = nullptr);
     ~MindMapNode();
 
+    // 虚拟化显示时图形项从池中取用，换绑到另一条记录
+    void rebind(const NodeRecord& record);
+    void unbind();   // 回收进池时清空路径，再次进入场景时不会以旧路径登记
+    int modelIndex() const { return m_modelIndex; }   // 对应的模型下标，非虚拟化为 -1
+    void setModelIndex(int index) { m_modelIndex = index; }
+
     // 重写图形项接口
     QRectF boundingRect() const override;
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget = nullptr) override;
 
-    // JSON存储
+    // JSON存储（内存文档为权威版本，落盘由延迟写入队列负责）
     QJsonObject getJson() const;
     void applyJson(const QJsonObject& json);
     void saveToJson();
+    void markDirty();   // 标记待写，由场景的延迟写入队列合并落盘
+    // 最近一次读出或写出的文档内容散列，写出前比较，内容没变就不写
+    quint64 savedHash() const { return m_savedHash; }
+    void setSavedHash(quint64 hash) { m_savedHash = hash; }
     void loadFromJson();
     QJsonObject toJson() const;
     void fromJson(const QJsonObject& json);
     void changeJson(const QString& header, const QString& info, const QString& action);
+    // 内存文档中成员状态之外的字段，用于统计内存占用
+    const QJsonObject& document() const { return m_document; }
 
     // 节点操作
     void setText(const QString& text);
@@ -36,25 +59,36 @@ public:
     void setColor(const QColor& color);
     QColor color() const;
     void addTag(const QString& tag);
+    void removeTag(const QString& tag);
+    QStringList tags() const;
+    const QList<quint32>& tagIds() const { return m_tags; }   // 标签驻留表中的编号，有序
+    bool hasTag(quint32 id) const;
 
     // 文件夹路径操作
     void setFolderPath(const QString& path);
     QString folderPath() const;
+    QString folderName() const;
     QDir directory() const;
 
     // 子节点管理
     void addChild(MindMapNode* child);
+    void attachChild(MindMapNode* child);
+    void sortChildren();    // 按文件夹名排序，与目录列举顺序一致
     void removeChild(const QString& name);
     void removeAllChild();
     void loadChild(const QString& name);
     void loadAllChild();
     void hideChild(MindMapNode* child);
     void hideAllChild();
-    QList<MindMapNode*> children() const;
+    bool hasChildren() const;   // 包括尚未加载为图形项的子节点
+    // 不复制列表；遍历期间不要增删子节点，需要时先自行复制
+    const QList<MindMapNode*>& children() const { return m_children; }
+    MindMapNode* child(const QString& name) const { return m_childIndex.value(name); } // 按文件夹名查找已加载的子节点
 
     // 连接管理
     void addConnection(Connection* connection);
     void removeConnection(Connection* connection);
+    void releaseConnection(Connection* connection); // 连线析构时调用，不标记修改
     QList<Connection*> connections() const;
 
     // 节点关系
@@ -65,12 +99,20 @@ public:
     bool isExpanded() const { return m_expanded; }
     void setExpanded(bool expanded);
     void toggleExpanded();
-    QRectF expandButtonRect() const;
+    QRectF expandButtonRect() const { return m_buttonRect; }
+
+    // 标签筛选时淡化：只影响本节点自己的绘制，不像 setOpacity 那样连带子节点
+    void setDimmed(bool dimmed);
+    bool isDimmed() const { return m_dimmed; }
+
+    // 重新测量文字并更新缓存的几何信息（文字或字体变化时调用）
+    void updateGeometry();
 
 
 
     // 位置信息
     void setPosition(const QPointF& pos);
+    void commitPosition();   // 当前位置记入编辑日志并标记待写
     QPointF position() const { return pos(); }
 
     // 类型标识
@@ -80,16 +122,42 @@ public:
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
     void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
 
 private:
+    MindMapScene* mindMapScene() const;
+    SaveQueue* saveQueue() const;
+    QFont labelFont() const;
+    QSharedPointer<MapStorage> storage() const;
+    void recordEdit(const QString& op, const QJsonValue& value); // 追加到编辑日志
+    void destroyChild(MindMapNode* child); // 回收子节点图形项及其子树，不动磁盘
+    void destroyChildren();                // 整批回收全部子节点
+    void dispose(MindMapNode* child);      // 回收已从列表摘下的子节点
+    void pathChanged(const QString& oldName); // 更新父节点的子节点索引并通知场景
+    MindMapNode* createChild(const NodeRecord& record); // 优先从回收池取用
+    void assignPath(const QString& path);  // 尽量拆成相对父节点的一段保存
+    void insertTag(quint32 id);
+    void keepDocument(const QJsonObject& json); // 去掉成员中已有的字段后保存为内存文档
+
     QString m_text;
-    QColor m_color;
-    QString m_folderPath;
+    quint16 m_colorIndex;   // 调色板下标
+    QString m_segment;      // 相对父节点的文件夹名；没有父节点时为绝对路径
     QList<MindMapNode*> m_children;
+    QHash<QString, MindMapNode*> m_childIndex; // 文件夹名 -> 子节点
     QList<Connection*> m_connections;
-    QList<QString> m_tags;
+    QList<quint32> m_tags;  // 标签编号集合
+    QJsonObject m_document; // 节点文档中成员状态之外的字段（children 等）
+    QRectF m_boundingRect;  // 缓存的几何信息，只在文字或字体变化时重算
+    QRectF m_buttonRect;
+    QStaticText m_label;    // 排版好的标签文字
+    QPointF m_labelPos;
     bool m_expanded; // 是否展开子节点
     bool m_loading;  // 是否正在加载中（防止保存循环）
+    bool m_hasUnloadedChildren; // 是否还有子节点只存在于磁盘上
+    bool m_relativePath;        // m_segment 是否相对父节点
+    bool m_dimmed;              // 是否被标签筛选淡化
+    int m_modelIndex;
+    quint64 m_savedHash;
 };
 
 #endif // MINDMAPNODE_H
\ No newline at end of file
@@ -3,18 +3,132 @@
 
 #include <QGraphicsScene>
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <functional>
 #include "MindMapNode.h"
+#include "MapStorage.h"
+#include "MapJournal.h"
+#include "LayoutEngine.h"
+#include "NodeStyleCache.h"
+#include "EdgeLayer.h"
+#include "MapModel.h"
+#include "ItemPool.h"
+#include "TagIndex.h"
+#include "SearchIndex.h"
+#include "LinkTable.h"
+
+class SaveQueue;
+class Connection;
+class MapLoader;
+struct MapIndexes;
+class LayoutWorker;
+class ViewportVirtualizer;
+class DragSession;
+class QTimer;
 
 class MindMapScene : public QGraphicsScene
 {
     Q_OBJECT
 public:
     explicit MindMapScene(QObject* parent = nullptr);
+    ~MindMapScene();
 
     // 文件操作
     bool createNewMap(const QString& path);
-    bool openMap(const QString& path);
-    bool saveMap();
+    bool openMap(const QString& path);   // 异步打开，完成时发出 openFinished
+    void cancelOpen();
+    bool isOpening() const;
+    int saveMap();         // 返回上次保存以来写出的节点数，没有打开的图时返回 -1
+    void flushPending();   // 写出延迟队列中的全部修改
+
+    // 存储格式，下次保存时生效
+    void setStorageFormat(MapStorage::Format format) { m_format = format; }
+    MapStorage::Format storageFormat() const { return m_format; }
+    // 节点文档写入的持久化程度，默认每批写入返回前都已落盘
+    void setDurability(DurableWriter::Durability durability);
+    DurableWriter::Durability durability() const;
+
+    // 按需加载：折叠节点的子树只以磁盘记录存在，展开时才创建图形项
+    void setLazyLoading(bool lazy) { m_lazyLoading = lazy; }
+    bool lazyLoading() const { return m_lazyLoading; }
+    // 虚拟化显示（下次打开时生效）：整棵树只存在于轻量模型中，
+    // 只为视口附近的节点创建图形项。此模式下不能增删节点。
+    void setVirtualized(bool virtualized) { m_virtualized = virtualized; }
+    bool isVirtualized() const { return m_virtualized; }
+    bool hasModel() const { return m_modelActive; }   // 当前图是否以模型显示
+    // 图形项预算：节点数超出时释放折叠最久的子树
+    void setItemBudget(int budget);
+    int itemBudget() const { return m_itemBudget; }
+    int nodeCount() const { return m_nodeCount; }
+
+    // 追加一条编辑记录（由 MindMapNode 调用）
+    void recordEdit(const QString& op, const QString& folderPath, const QJsonValue& value);
+
+    // 节点生命周期通知（由 MindMapNode 调用）
+    void nodeAdded(MindMapNode* node);
+    void nodeRemoved(MindMapNode* node);
+    void nodeExpandedChanged(MindMapNode* node);
+    void nodePathChanged(MindMapNode* node);
+    // 按文件夹路径查找已加载为图形项的节点
+    MindMapNode* nodeAt(const QString& folderPath) const;
+    MindMapNode* linkTarget(const MindMapNode* source, const QString& link) const;
+
+    // 跨节点连线：记入连线表并在两端都已加载时显示
+    bool linkNodes(MindMapNode* source, MindMapNode* destination);
+    bool unlinkNodes(MindMapNode* source, MindMapNode* destination);
+    const LinkTable& links() const { return m_links; }
+    void nodeStructureChanged(MindMapNode* node); // 子节点增删，需要重排
+    void nodeMoved(MindMapNode* node);
+    void connectionMoved(const Connection* connection);   // 由连线层绘制的连线端点移动
+    void connectionRemoved(const Connection* connection);
+
+    // 连线合并到一个图形项绘制（默认开启）；关闭时每条连线是独立的图形项
+    void setEdgeLayerEnabled(bool enabled);
+    bool edgeLayerEnabled() const { return m_edgeLayerEnabled; }
+    EdgeLayer* edgeLayerItem() const { return m_edgeLayer; }   // 尚未创建时为空
+
+    // 鼠标拖动节点期间的连线更新和位置保存
+    DragSession* dragSession() const { return m_dragSession; }
+
+    // 批量更新：期间关闭场景索引，节点移动不再逐个保存、更新连线，
+    // 结束时一次性重建索引和连线。可嵌套，用 BulkUpdate 限定作用域。
+    void beginBulkUpdate();
+    void endBulkUpdate();
+    bool isBulkUpdating() const { return m_bulkDepth > 0; }
+
+    class BulkUpdate
+    {
+    public:
+        explicit BulkUpdate(MindMapScene* scene) : m_scene(scene) { m_scene->beginBulkUpdate(); }
+        ~BulkUpdate() { m_scene->endBulkUpdate(); }
+    private:
+        Q_DISABLE_COPY(BulkUpdate)
+        MindMapScene* m_scene;
+    };
+
+    // 标签查询：整张图的倒排索引，包括尚未加载的节点；索引在后台建立期间返回空
+    QStringList findByTags(const QStringList& tags, TagIndex::Match match);
+    // 选中已加载的匹配节点，filter 为真时淡化其余节点；tags 为空时清除。返回匹配总数。
+    // 索引还没建好时返回 0，建好后自动重新执行
+    int highlightByTags(const QStringList& tags, TagIndex::Match match, bool filter);
+    void nodeTagChanged(MindMapNode* node, const QString& tag, bool added);
+
+    // 全文搜索：节点文字和标签，覆盖尚未加载的节点；后台建索引期间返回空
+    QStringList search(const QString& text, int limit);
+    bool isIndexing() const { return m_indexing; }
+    // 展开祖先、选中并把视图移到该节点
+    bool revealNode(const QString& folderPath);
+    void nodeTextChanged(MindMapNode* node);
+
+    // 已加载节点的路径、标签、颜色字段占用：按旧的逐节点保存方式与驻留后的方式分别估算
+    QString memoryReport() const;
+
+    SaveQueue* saveQueue() const { return m_saveQueue; }
+    NodeStyleCache* styleCache() { return &m_styleCache; }
+    ItemPool* itemPool() { return &m_itemPool; }   // 节点和连线图形项的回收池
 
     // 节点操作
     void removeNode(MindMapNode* node);
@@ -24,14 +138,23 @@ public:
     MindMapNode* rootNode() const { return m_rootNode; }
     QString mapPath() const { return m_mapPath; }
 
-    // 布局功能
+    // 布局功能：全量重排；编辑后的增量重排由场景自动合并执行
     void updateLayout();
+    void setLayoutMode(LayoutMode mode);
+    LayoutMode layoutMode() const { return m_layout.mode(); }
 
     // 折叠/展开功能
-    void recursiveSave(MindMapNode* node);
     void recursiveSetExpanded(MindMapNode* node, bool expanded);
+    void setAllExpanded(bool expanded);
+
+signals:
+    void openStarted(const QString& path);
+    void openProgress(int loaded);
+    void openFinished(bool ok);
+    void indexesReady();   // 后台索引建好，之前的搜索可以重新执行
 
 protected:
+    bool event(QEvent* event) override;
     void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
 
 private:
@@ -40,12 +163,89 @@ private:
     void showNodeContextMenu(MindMapNode* node, const QPoint& screenPos);
     void showSceneContextMenu(const QPoint& screenPos, const QPointF& scenePos);
 
-    void recursiveLayout(MindMapNode* node, qreal x, qreal& y, int depth);
-    void recursiveLoadChildren(MindMapNode* parent);
-    void restoreConnections(MindMapNode* node);
+    void scheduleLayout();
+    void applyLayout();
+    void startFullLayout(bool center);
+    void edgesChanged();   // 整体重建连线层
+    EdgeLayer* syncingEdgeLayer();   // 可以逐条同步时返回连线层
+    EdgeLayer* edgeLayer();
+    void clearMap();
+    void layoutModel(bool center);
+    void finishModelLayout(const LayoutSnapshot& snapshot);
+    void endOpenBulkUpdate();
+    void finishFullLayout(const LayoutSnapshot& snapshot);
+    void appendRecords(const QList<NodeRecord>& records);
+    void finishOpen(bool ok);
+    void recursiveSortChildren(MindMapNode* node);
+    void enforceItemBudget();
+    bool openJournal(const QString& path, MapStorage& storage);   // 返回是否回放过日志
+    void startIndexing();
+    void installIndexes(const QSharedPointer<MapIndexes>& indexes);
+    void recordIndexChange(const std::function<void()>& change);
+    MindMapNode* findNode(const QString& folderPath, bool expand);
+    void indexNode(MindMapNode* node);
+    void unindexNode(MindMapNode* node);
+    void connectNodes(MindMapNode* source, MindMapNode* destination); // 创建连线图形项
+    void restoreLinks();        // 为整张图已加载的节点恢复连线
+    void restorePendingLinks(); // 为新加载的节点补上连线
+    void centerOnReveal();
+    void markTagMatches(MindMapNode* node, const QString& path, const QSet<QString>& matches, bool filter);
 
     MindMapNode* m_rootNode; // 根节点
     QString m_mapPath;
+    SaveQueue* m_saveQueue;  // 延迟写入队列
+    MapStorage::Format m_format;
+    QSharedPointer<MapJournal> m_journal; // 编辑日志
+    MapLoader* m_loader;     // 异步加载器
+    QHash<int, MindMapNode*> m_loadingNodes; // 加载中：记录编号 -> 节点
+
+    bool m_lazyLoading;
+    int m_itemBudget;
+    int m_nodeCount;
+    QHash<QString, MindMapNode*> m_nodesByPath;     // 规范化的文件夹路径 -> 节点
+    QHash<const MindMapNode*, QString> m_nodePaths; // 登记时的键，删除时用
+    QHash<MindMapNode*, qint64> m_collapsedAt; // 折叠节点 -> 折叠时刻
+    QElapsedTimer m_clock;
+    QTimer* m_budgetTimer;
+    QTimer* m_linkTimer;
+    QSet<MindMapNode*> m_linkPending;   // 新加载、待补连线的节点
+
+    LayoutEngine m_layout;   // 增量布局
+    QTimer* m_layoutTimer;   // 合并同一轮事件中的多次重排
+    LayoutWorker* m_layoutWorker; // 大图的全量布局放到后台计算
+    int m_structureVersion;  // 节点增删、展开折叠时递增，用于作废过期的布局结果
+    bool m_centerAfterLayout;
+
+    NodeStyleCache m_styleCache; // 节点背景共享位图
+    ItemPool m_itemPool;         // 池中图形项不在场景中，随场景析构删除
+
+    bool m_edgeLayerEnabled;
+    QPointer<EdgeLayer> m_edgeLayer; // 随场景清空一起删除
+
+    int m_bulkDepth;
+    ItemIndexMethod m_indexMethod;   // 批量更新前的索引方式
+    bool m_openBulk;                 // 异步打开期间处于批量更新中
+    bool m_clearing;                 // 场景清空中，忽略节点析构的通知
+
+    bool m_virtualized;
+    bool m_modelActive;
+    MapModel m_model;
+    ViewportVirtualizer* m_virtualizer;
+
+    DragSession* m_dragSession;
+
+    TagIndex m_tagIndex;
+    bool m_indexFromLoad;    // 本次打开时顺带从记录建立标签索引
+    SearchIndex m_searchIndex;
+    bool m_searchFromLoad;
+    LinkTable m_links;
+    bool m_linksFromLoad;
+    bool m_indexing;         // 后台正在建立索引
+    QVector<std::function<void()>> m_indexChanges; // 建索引期间的修改，建好后重放
+    QStringList m_highlightTags;     // 索引建好前请求的标签筛选，建好后重新执行
+    TagIndex::Match m_highlightMatch;
+    bool m_highlightFilter;
+    QString m_revealPath;    // 布局完成后要定位的节点
 };
 
 #endif // MINDMAPSCENE_H
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef NODERECORD_H
+#define NODERECORD_H
+
+#include <QString>
+#include <QJsonObject>
+
+// 加载阶段使用的轻量节点记录，不依赖图形项
+struct NodeRecord
+{
+    int id = -1;         // 记录编号
+    int parent = -1;     // 父记录编号，根节点为 -1
+    QString name;        // 文件夹名
+    QString path;        // 文件夹绝对路径
+    QJsonObject json;    // node.json 文档内容
+    bool hasChildren = false; // 是否有子文件夹（子节点未必已加载）
+    quint64 hash = 0;    // 读出时文档的内容散列，0 表示未计算
+};
+
+#endif // NODERECORD_H
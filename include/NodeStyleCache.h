@@ -0,0 +1,43 @@
+#ifndef NODESTYLECACHE_H
+#define NODESTYLECACHE_H
+
+#include <QCache>
+#include <QColor>
+#include <QPixmap>
+#include <QRectF>
+
+class QPainter;
+
+// 节点背景（渐变圆角框、选中边框）的共享位图缓存。
+// 节点之间只有颜色、尺寸和状态不同，按（颜色, 尺寸档, 状态, 设备像素比）
+// 预先渲染一次，绘制时直接贴图；总占用有上限，按最近最少使用淘汰。
+// 节点尺寸本身按档取整，贴图与节点一样大，不经缩放；悬停高亮盖在文字上，不进缓存。
+class NodeStyleCache
+{
+public:
+    enum State
+    {
+        Normal = 0,
+        Selected = 1
+    };
+
+    explicit NodeStyleCache(int maxKilobytes = 32 * 1024);
+
+    // 节点尺寸取整到的档位
+    static QSize bucketSize(const QSizeF& size);
+    // 按档取整后的背景图，以自身尺寸贴在节点矩形的左上角；
+    // 超出键能表示的尺寸时返回空图，由调用方矢量绘制
+    QPixmap background(const QColor& color, const QSizeF& size, int state, qreal devicePixelRatio);
+    // 直接用矢量绘制背景（缓存未命中时渲染，放大查看时也用它）
+    static void paintBackground(QPainter* painter, const QRectF& rect, const QColor& color, int state);
+    static void paintHover(QPainter* painter, const QRectF& rect);
+
+    void setMaxKilobytes(int maxKilobytes) { m_cache.setMaxCost(maxKilobytes); }
+    int usedKilobytes() const { return int(m_cache.totalCost()); }
+    void clear() { m_cache.clear(); }
+
+private:
+    QCache<quint64, QPixmap> m_cache;
+};
+
+#endif // NODESTYLECACHE_H
@@ -0,0 +1,63 @@
+#ifndef PACKEDSTORAGE_H
+#define PACKEDSTORAGE_H
+
+#include "MapStorage.h"
+#include <QMutex>
+#include <QByteArray>
+#include <QSet>
+
+// 单文件打包后端：整张图的节点文档以 CBOR 形式顺序存放在根目录的
+// mindmap.pack 中，文件末尾是 [相对路径, 偏移, 长度] 索引。
+// 打开时映射文件，只需一次打开和一次读取即可重建整棵树。
+//
+// 延迟写入的每一批只把改动的文档追加到旁边的 mindmap.packlog，
+// 代价与改动量成正比；保存、关闭或追加日志过大时才整体重写打包文件并删除日志。
+// 日志头记录它所依附的打包文件代数，重写后残留的旧日志不会被回放。
+//
+// 文件布局：
+//   打包文件 "MMPK" | 版本 u32 | 索引偏移 u64 | 代数 u64 | 节点记录... | 索引
+//   追加日志 "MMPL" | 代数 u64 | [长度 u32 | CBOR [操作, 相对路径, 文档]]...
+class PackedStorage : public MapStorage
+{
+public:
+    explicit PackedStorage(const QString& rootPath);
+
+    Format format() const override { return PackedFormat; }
+
+    bool load(QList<NodeRecord>& records) override;
+    QJsonObject readNode(const QString& folderPath) const override;
+    QStringList childNames(const QString& folderPath) const override;
+    bool writeNodes(const QHash<QString, QJsonObject>& documents) override;
+    void removeTree(const QString& folderPath) override;
+    bool sync() override;
+    bool compact() override;
+
+    static QString fileName() { return QStringLiteral("mindmap.pack"); }
+    static QString logFileName() { return QStringLiteral("mindmap.packlog"); }
+    QString filePath() const;
+    QString logFilePath() const;
+
+private:
+    QString relativePath(const QString& folderPath) const;
+    static QString parentOf(const QString& rel);
+    // 以下函数要求调用方持有 m_mutex
+    bool readPack() const;
+    void readLog() const;
+    void buildTree(QList<NodeRecord>* records) const;
+    void ensureLoaded() const;
+    bool writePack();
+    bool appendLog();
+
+    mutable QMutex m_mutex;
+    mutable QHash<QString, QByteArray> m_entries; // 相对路径 -> CBOR 编码的节点文档
+    mutable QHash<QString, QStringList> m_children; // 相对路径 -> 子文件夹名
+    mutable quint64 m_generation; // 磁盘上打包文件的代数
+    mutable qint64 m_packSize;
+    mutable qint64 m_logSize;     // 追加日志的字节数，0 表示没有有效日志
+    mutable bool m_loaded;        // 是否已读入磁盘上的打包文件
+    QSet<QString> m_written;      // 上次落盘后写入过的文档
+    QStringList m_removed;        // 上次落盘后删除的子树，按删除顺序
+    bool m_modified;
+};
+
+#endif // PACKEDSTORAGE_H
@@ -0,0 +1,97 @@
+#ifndef SAVEQUEUE_H
+#define SAVEQUEUE_H
+
+#include <QObject>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+#include <QThreadPool>
+#include <QMutex>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include "MapStorage.h"
+#include "MapJournal.h"
+#include "NodeRecord.h"
+
+class MindMapNode;
+
+// 延迟写入队列：节点只做脏标记，同一节点的多次修改合并为一次写入，
+// 由定时器在后台线程统一写入存储后端，关闭或保存时同步刷新。
+// 写出前比较文档的内容散列，与上次读出或写出时相同的节点不再写；
+// 节点记下的散列在写入线程确认写入成功后才更新，提交中的以提交时的散列比较。
+// 一批写入失败时不截断编辑日志，这批文档留在写入线程中并入下一批重写。
+// 展开、折叠等交互路径只把文档交给存储（handOff），不刷盘也不截断日志，
+// 这些文档同样并入下一次由定时器或保存触发的持久提交。
+class SaveQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SaveQueue(QObject* parent = nullptr);
+    ~SaveQueue();
+
+    // 设置写入目标；切换前应先 flush
+    void setStorage(const QSharedPointer<MapStorage>& storage);
+    QSharedPointer<MapStorage> storage() const { return m_storage; }
+    // 写入完成后截掉编辑日志中已落盘的部分
+    void setJournal(const QSharedPointer<MapJournal>& journal);
+    // 节点文档写入的持久化程度，作用于当前及之后设置的存储
+    void setDurability(DurableWriter::Durability durability);
+    DurableWriter::Durability durability() const { return m_durability; }
+
+    // 标记节点需要写回磁盘
+    void markDirty(MindMapNode* node);
+    // 删除子树：丢弃子树中待写的文档，再从存储中移除
+    void removeTree(const QString& folderPath);
+    // 节点离开场景或析构时调用，丢弃其待写标记
+    void forget(MindMapNode* node);
+    // 图形项即将换绑到另一个节点：把待写的文档留在队列中随下一批写出，不必立即落盘
+    void detach(MindMapNode* node, const QJsonObject& json);
+    // 按需加载时用队列中还没写入存储的文档覆盖从存储读出的记录，
+    // 并补上新建后还没写入存储的子节点，不必等待写入完成
+    void overlay(NodeRecord& record) const;
+    void overlayChildren(const QString& folderPath, QList<NodeRecord>& records) const;
+    // 立即写出全部待写节点并等待后台写入完成，返回实际写出的节点数
+    int flush();
+    // 把待写节点交给存储并等待写入完成，之后从存储读到的即是最新内容；
+    // 不刷盘、不截断编辑日志，供交互路径使用，持久化留给下一次提交
+    int handOff();
+    // 上次调用以来成功写入存储的节点数（同一节点只计一次），随后清零
+    int takeWrittenCount();
+
+    void setInterval(int msec);
+    int interval() const { return m_timer.interval(); }
+    int pendingCount() const;
+    bool isPending(MindMapNode* node) const { return m_dirty.contains(node); }
+
+private:
+    int writeBehind();
+    QHash<QString, QJsonObject> takeBatch();
+    void submit(const QHash<QString, QJsonObject>& batch, bool durable);
+    // 路径的最新待写文档：已换绑图形项留下的、已提交正在写的、失败或未刷盘的，依次从新到旧
+    bool pendingDocument(const QString& path, QJsonObject* json) const;
+    QStringList pendingPaths() const;
+    // 节点上次提交、尚未确认写入的文档散列，没有时为已保存的散列
+    quint64 lastHash(MindMapNode* node) const;
+    // 把写入线程确认成功的散列记到节点上
+    void applyConfirmed();
+    // 以下两个函数在写入线程调用
+    bool write(const QSharedPointer<MapStorage>& storage, const QHash<QString, QJsonObject>& submitted, bool durable);
+    void retryLater();
+
+    QSharedPointer<MapStorage> m_storage;
+    QSharedPointer<MapJournal> m_journal;
+    qint64 m_checkpoint;  // 最近一次提交时的日志位置
+    DurableWriter::Durability m_durability;
+    QSet<MindMapNode*> m_dirty;
+    QHash<MindMapNode*, quint64> m_inFlight; // 已提交、尚未确认写入的文档散列
+    QHash<QString, QJsonObject> m_detached; // 已换绑图形项留下的待写文档
+    mutable QMutex m_mutex;                  // 保护以下四项，写入线程也会访问
+    QHash<QString, QJsonObject> m_submitted; // 已提交给写入线程、还没写完的文档
+    QHash<QString, QJsonObject> m_unsynced;  // 写入失败或只交给存储未刷盘、等待并入下一次提交的文档
+    QSet<QString> m_written;                 // 已成功写入、尚未报告的节点路径
+    QHash<QString, quint64> m_confirmed;     // 已成功写入、尚未记到节点上的文档散列
+    QTimer m_timer;
+    QThreadPool m_writer; // 单线程，保证同一文件的写入顺序
+};
+
+#endif // SAVEQUEUE_H
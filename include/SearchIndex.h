@@ -0,0 +1,62 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "NodeRecord.h"
+#include "SymbolTable.h"
+
+// 节点文字和标签的三元组全文索引，覆盖整张图（包括尚未加载为图形项的节点）。
+// 每个节点的可搜索内容（小写的文字和标签）拆成相邻三个字符的组合，
+// 每个三元组对应有序的节点编号数组。查询时对查询串的全部三元组求交，
+// 再在候选中核对子串；不足三个字符的查询直接顺序扫描，取够数量即停。
+// 节点以相对根目录的路径标识，随文字、标签修改和节点增删增量更新。
+// 与标签索引一样保存在根目录下，保存后的第一次修改会删除磁盘上的索引文件，
+// 未保存就崩溃时下次打开重建。
+//
+// 文件布局（QDataStream）：
+//   "MMSI" | 版本 u32 | 节点路径表 | 各节点内容 | 三元组 -> 节点编号数组
+class SearchIndex
+{
+public:
+    static QString fileName() { return QStringLiteral("search.index"); }
+
+    void reset(const QString& rootPath);
+    bool load();          // 读入已保存的索引，失败时保持为空
+    bool save();          // 只在有修改时写出
+    void discard();       // 删除已保存的索引（已过期）
+    void rebuild(const QList<NodeRecord>& records);
+
+    bool isComplete() const { return m_complete; }
+    void setComplete(bool complete) { m_complete = complete; }
+
+    // 登记或更新一个节点的内容
+    void update(const QString& folderPath, const QString& text, const QStringList& tags);
+    void addRecord(const NodeRecord& record);
+    void removeTree(const QString& folderPath);
+
+    // 返回至多 limit 个匹配节点的文件夹绝对路径，按登记顺序（父节点在前）
+    QStringList search(const QString& query, int limit) const;
+    int size() const { return m_live; }
+
+private:
+    static quint64 trigramKey(const QChar* chars);
+    static QString content(const QString& text, const QStringList& tags);
+    void insert(int id, const QString& content);
+    void erase(int id);
+    QString relativePath(const QString& folderPath) const;
+    QString absolutePath(const QString& rel) const;
+    void markModified();
+
+    QString m_rootPath;
+    SymbolTable m_nodes;                         // 相对路径 <-> 节点编号
+    QVector<QString> m_contents;                 // 节点编号 -> 小写内容，已删除为空
+    QHash<quint64, QVector<int>> m_postings;     // 三元组 -> 有序节点编号
+    int m_live = 0;
+    bool m_complete = false;
+    bool m_modified = false;
+};
+
+#endif // SEARCHINDEX_H
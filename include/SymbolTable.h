@@ -0,0 +1,31 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// 字符串驻留表：相同内容只保存一份，按登记顺序编号。
+// 标签、路径段这类取值集中的字符串在节点间共享，节点只保存编号或共享副本。
+// 只在GUI线程使用。
+class SymbolTable
+{
+public:
+    int id(const QString& name);          // 不存在时登记
+    int find(const QString& name) const;  // 不存在时返回 -1
+    QString name(int id) const { return m_names.value(id); }
+    // 返回与表中共享数据的副本，节点间不再各自持有一份
+    QString intern(const QString& name) { return m_names[id(name)]; }
+
+    int size() const { return m_names.size(); }
+    qint64 bytes() const;   // 表自身的估算占用
+
+    static SymbolTable& tags();       // 标签
+    static SymbolTable& segments();   // 文件夹名（路径段）
+
+private:
+    QHash<QString, int> m_ids;
+    QVector<QString> m_names;
+};
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,60 @@
+#ifndef TAGINDEX_H
+#define TAGINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "NodeRecord.h"
+#include "SymbolTable.h"
+
+// 整张图的标签倒排索引：标签 -> 带该标签的节点（含尚未加载为图形项的节点）。
+// 节点以相对根目录的路径标识并编号，每个标签对应一个有序的节点编号数组，
+// 与/或查询是有序数组的求交与合并。随标签增删增量维护，保存在根目录下，
+// 打开时直接读入，不必遍历全部节点文档。保存后的第一次修改会删除磁盘上的
+// 索引文件，未保存就崩溃时下次打开重建，不会用到与节点文档不符的索引。
+//
+// 文件布局（QDataStream）：
+//   "MMTI" | 版本 u32 | 节点路径表 | 标签数 | [标签, 节点编号数组]...
+class TagIndex
+{
+public:
+    enum Match { MatchAll, MatchAny };
+
+    static QString fileName() { return QStringLiteral("tags.index"); }
+
+    void reset(const QString& rootPath);   // 切换到另一张图，清空内容
+    bool load();                           // 读入已保存的索引，失败时保持为空
+    bool save();                           // 只在有修改时写出
+    void discard();                        // 删除已保存的索引（已过期）
+    // 由全部节点记录重建
+    void rebuild(const QList<NodeRecord>& records);
+
+    bool isComplete() const { return m_complete; }
+    void setComplete(bool complete) { m_complete = complete; }
+
+    // 加载记录时登记节点的全部标签
+    void addNode(const QString& folderPath, const QStringList& tags);
+    void add(const QString& folderPath, const QString& tag);
+    void remove(const QString& folderPath, const QString& tag);
+    // 删除以该文件夹为根的整棵子树
+    void removeTree(const QString& folderPath);
+
+    // 返回匹配节点的文件夹绝对路径
+    QStringList query(const QStringList& tags, Match match) const;
+    QStringList tags() const { return m_postings.keys(); }
+    int count(const QString& tag) const { return m_postings.value(tag).size(); }
+
+private:
+    QString relativePath(const QString& folderPath) const;
+    QString absolutePath(const QString& rel) const;
+    void markModified();
+
+    QString m_rootPath;
+    SymbolTable m_nodes;                        // 相对路径 <-> 节点编号
+    QHash<QString, QVector<int>> m_postings;    // 标签 -> 有序节点编号
+    bool m_complete = false;   // 是否覆盖了整张图
+    bool m_modified = false;
+};
+
+#endif // TAGINDEX_H
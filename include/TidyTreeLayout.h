@@ -0,0 +1,38 @@
+#ifndef TIDYTREELAYOUT_H
+#define TIDYTREELAYOUT_H
+
+#include <QVector>
+#include "LayoutSnapshot.h"
+
+// 紧凑树布局（Walker 算法，按 Buchheim 等人的线性时间实现）。
+// 在扁平快照上运行，不接触图形项，可在工作线程调用。
+// 根节点在左、子树向右展开；balanced 时根的子树按大小分到左右两侧。
+class TidyTreeLayout
+{
+public:
+    explicit TidyTreeLayout(LayoutSnapshot& snapshot);
+
+    void run(bool balanced);
+
+private:
+    void layoutChildren(int v, const QVector<int>& kids);
+    int apportion(int v, int k, const QVector<int>& kids, int defaultAncestor);
+    void moveSubtree(int wl, int wr, qreal shift);
+    void executeShifts(const QVector<int>& kids);
+    int nextLeft(int v) const;
+    int nextRight(int v) const;
+    qreal distance(int a, int b) const;
+
+    LayoutSnapshot& m_flat;
+    QVector<int> m_lastChild;
+    QVector<int> m_number;     // 在兄弟节点中的序号
+    QVector<int> m_thread;
+    QVector<int> m_ancestor;
+    QVector<qreal> m_prelim;
+    QVector<qreal> m_mod;
+    QVector<qreal> m_shift;
+    QVector<qreal> m_change;
+    QVector<qreal> m_offset;   // 根的子节点在其所在一侧的居中偏移
+};
+
+#endif // TIDYTREELAYOUT_H
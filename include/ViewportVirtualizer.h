@@ -0,0 +1,43 @@
+#ifndef VIEWPORTVIRTUALIZER_H
+#define VIEWPORTVIRTUALIZER_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
+#include <QPointer>
+#include <QGraphicsView>
+
+class MindMapScene;
+class MindMapNode;
+class MapModel;
+
+// 视口虚拟化：只为视口（外加一圈余量）内的模型节点创建图形项，
+// 移出视口的图形项放回场景的回收池复用，内存和帧耗时只与屏幕大小有关。
+class ViewportVirtualizer : public QObject
+{
+    Q_OBJECT
+public:
+    ViewportVirtualizer(MindMapScene* scene, MapModel* model, QObject* parent = nullptr);
+
+    void attach(QGraphicsView* view);
+    void scheduleRefresh();
+    void refresh();     // 按当前视口创建、移动、回收图形项
+    void reset();       // 场景清空前调用，丢弃全部图形项指针
+
+    int liveCount() const { return m_live.size(); }
+    MindMapNode* item(int index) const { return m_live.value(index); }
+
+private:
+    QRectF visibleRect() const;
+    MindMapNode* acquire(int index);
+    void release(MindMapNode* node);
+
+    MindMapScene* m_scene;
+    MapModel* m_model;
+    QPointer<QGraphicsView> m_view;
+    QHash<int, MindMapNode*> m_live;   // 模型下标 -> 图形项
+    QTimer m_timer;                    // 合并连续滚动
+};
+
+#endif // VIEWPORTVIRTUALIZER_H
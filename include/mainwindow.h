@@ -2,12 +2,16 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QPointer>
 #include "MindMapScene.h"
 
 class QGraphicsView;
 class QToolBar;
 class QAction;
 class QStatusBar;
+class QCloseEvent;
+class QProgressDialog;
+class QLineEdit;
 
 class MainWindow : public QMainWindow
 {
@@ -15,22 +19,41 @@ class MainWindow : public QMainWindow
 public:
     explicit MainWindow(QWidget* parent = nullptr);
 
+protected:
+    void closeEvent(QCloseEvent* event) override;
+
 private:
     void createActions();
     void createToolBar();
     void createStatusBar();
+    void connectSceneSignals();
+    void updateSearch();
 
     MindMapScene* m_scene;
     QGraphicsView* m_view;
+    QPointer<QProgressDialog> m_openProgress;
 
     QAction* m_newAction;
     QAction* m_openAction;
     QAction* m_saveAction;
+    QAction* m_packedAction;
+    QAction* m_durableAction;
     QAction* m_deleteAction;
     QAction* m_zoomInAction;
     QAction* m_zoomOutAction;
     QAction* m_expandAllAction;
     QAction* m_collapseAllAction;
+    QAction* m_outlineLayoutAction;
+    QAction* m_tidyLayoutAction;
+    QAction* m_balancedLayoutAction;
+    QAction* m_edgeLayerAction;
+    QAction* m_virtualAction;
+    QAction* m_tagFilterAction;
+    QAction* m_memoryAction;
+
+    QLineEdit* m_searchEdit;
+    QStringList m_searchHits;   // 当前搜索结果，回车依次定位
+    int m_searchPos;
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "ColorPalette.h"
+#include <QHash>
+#include <QVector>
+
+namespace {
+struct Palette
+{
+    Palette()
+    {
+        colors.append(QColor(135, 206, 250).rgba());
+        indices.insert(colors.first(), 0);
+    }
+
+    QVector<QRgb> colors;
+    QHash<QRgb, quint16> indices;
+};
+
+Palette& palette()
+{
+    static Palette instance;
+    return instance;
+}
+}
+
+quint16 ColorPalette::index(const QColor& color)
+{
+    Palette& p = palette();
+    const QRgb rgba = color.rgba();
+    auto it = p.indices.constFind(rgba);
+    if (it != p.indices.constEnd()) return it.value();
+
+    // 下标用满时退回默认颜色，实际的图远用不到这么多种
+    if (p.colors.size() > 0xFFFF) return 0;
+    const quint16 index = quint16(p.colors.size());
+    p.colors.append(rgba);
+    p.indices.insert(rgba, index);
+    return index;
+}
+
+QColor ColorPalette::color(quint16 index)
+{
+    const Palette& p = palette();
+    return QColor::fromRgba(index < p.colors.size() ? p.colors[index] : p.colors.first());
+}
+
+int ColorPalette::size()
+{
+    return palette().colors.size();
+}
@@ -1,4 +1,5 @@
 #include "Connection.h"
+#include "MindMapScene.h"
 #include <QPainterPath>
 #include <qpen.h>
 
@@ -7,18 +8,69 @@ Connection::Connection(MindMapNode* source, MindMapNode* destination, QGraphicsI
 {
     setPen(QPen(Qt::darkGray, 2, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
     setZValue(-1); // 确保在节点下方
+    // 挂在父节点下时随子树一起平移，绘制在父节点之下
+    setFlag(QGraphicsItem::ItemStacksBehindParent);
     updatePath();
 
     if (m_source) m_source->addConnection(this);
     if (m_destination) m_destination->addConnection(this);
 }
 
+Connection::~Connection()
+{
+    // 从仍然存活的端点中移除自己
+    unregister();
+    if (m_source) m_source->releaseConnection(this);
+    if (m_destination && m_destination != m_source) m_destination->releaseConnection(this);
+}
+
+void Connection::detach(MindMapNode* node)
+{
+    if (m_source == node) m_source = nullptr;
+    if (m_destination == node) m_destination = nullptr;
+}
+
+void Connection::reset()
+{
+    unregister();
+    if (m_source) m_source->releaseConnection(this);
+    if (m_destination && m_destination != m_source) m_destination->releaseConnection(this);
+    m_source = nullptr;
+    m_destination = nullptr;
+    setPath(QPainterPath());
+}
+
+void Connection::rebind(MindMapNode* source, MindMapNode* destination)
+{
+    m_source = source;
+    m_destination = destination;
+    setPos(0, 0);
+    updatePath();
+
+    if (m_source) m_source->addConnection(this);
+    if (m_destination) m_destination->addConnection(this);
+}
+
+void Connection::unregister()
+{
+    // 由连线层绘制时通知它删除这一条
+    if (scene()) return;
+    MindMapNode* node = m_source ? m_source : m_destination;
+    if (MindMapScene* owner = node ? qobject_cast<MindMapScene*>(node->scene()) : nullptr) owner->connectionRemoved(this);
+}
+
 void Connection::updatePath()
 {
     if (!m_source || !m_destination) return;
+    // 不在场景中时由连线层绘制，只更新连线层中这一条
+    if (!scene()) {
+        if (MindMapScene* owner = qobject_cast<MindMapScene*>(m_source->scene())) owner->connectionMoved(this);
+        return;
+    }
 
-    QPointF start = m_source->pos();
-    QPointF end = m_destination->pos();
+    // 节点坐标相对各自父项，统一换算到本项坐标系
+    QPointF start = mapFromItem(m_source, QPointF(0, 0));
+    QPointF end = mapFromItem(m_destination, QPointF(0, 0));
 
     // 创建曲线路径
     QPainterPath path;
@@ -0,0 +1,129 @@
+#include "DragSession.h"
+#include "MindMapScene.h"
+#include "MindMapNode.h"
+#include "Connection.h"
+#include "EdgeLayer.h"
+
+DragSession::DragSession(MindMapScene* scene)
+    : QObject(scene), m_scene(scene), m_pressed(nullptr), m_stale(false)
+{
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setInterval(16); // 约一帧
+    connect(&m_frameTimer, &QTimer::timeout, this, &DragSession::applyFrame);
+}
+
+void DragSession::press(MindMapNode* node)
+{
+    m_pressed = node;
+}
+
+bool DragSession::nodeMoved(MindMapNode* node)
+{
+    if (!m_pressed) return false;
+
+    // 多选拖动时各个根节点在同一次鼠标事件中依次移动，下一帧统一整理
+    if (!m_moving.contains(node)) {
+        m_roots.append({ node, node->scenePos() });
+        m_stale = true;
+    }
+    if (!m_frameTimer.isActive()) m_frameTimer.start();
+    return true;
+}
+
+void DragSession::nodeRemoved(MindMapNode* node)
+{
+    if (!isActive()) return;
+
+    for (int i = m_roots.size() - 1; i >= 0; --i) {
+        if (m_roots[i].node == node) m_roots.removeAt(i);
+    }
+    // 删除节点时连带删除的连线可能在列表中，下一帧前重新整理
+    m_stale = true;
+
+    if (node == m_pressed) {
+        // 收不到松开事件了，直接结束
+        m_frameTimer.stop();
+        for (const Root& root : std::as_const(m_roots)) root.node->commitPosition();
+        m_roots.clear();
+        m_moving.clear();
+        m_crossing.clear();
+        m_carried.clear();
+        m_pressed = nullptr;
+        if (EdgeLayer* layer = m_scene->edgeLayerItem()) layer->endDrag();
+    }
+}
+
+void DragSession::release()
+{
+    if (isActive()) {
+        if (m_stale || m_frameTimer.isActive()) applyFrame();
+        m_frameTimer.stop();
+
+        // 整个拖动只保存一次位置
+        for (const Root& root : std::as_const(m_roots)) root.node->commitPosition();
+        if (EdgeLayer* layer = m_scene->edgeLayerItem()) layer->endDrag();
+    }
+
+    m_roots.clear();
+    m_moving.clear();
+    m_crossing.clear();
+    m_carried.clear();
+    m_stale = false;
+    m_pressed = nullptr;
+}
+
+void DragSession::addSubtree(MindMapNode* node)
+{
+    m_moving.insert(node);
+    for (MindMapNode* child : node->children()) addSubtree(child);
+}
+
+void DragSession::collect()
+{
+    m_moving.clear();
+    m_crossing.clear();
+    m_carried.clear();
+    for (Root& root : m_roots) {
+        root.anchor = root.node->scenePos();
+        addSubtree(root.node);
+    }
+
+    // 挂在集合内节点下的连线随子树移动，不用处理
+    auto inside = [this](const QGraphicsItem* item) {
+        return item && item->type() == MindMapNode::Type
+            && m_moving.contains(static_cast<const MindMapNode*>(item));
+    };
+    for (const MindMapNode* node : std::as_const(m_moving)) {
+        for (Connection* connection : node->connections()) {
+            if (!connection->scene()) continue; // 由连线层绘制
+            const bool source = m_moving.contains(connection->sourceNode());
+            const bool destination = m_moving.contains(connection->destinationNode());
+            if (source && destination) {
+                if (connection->sourceNode() != node || inside(connection->parentItem())) continue;
+                m_carried.append({ connection, connection->pos() });
+            } else {
+                m_crossing.append(connection);
+            }
+        }
+    }
+    m_stale = false;
+
+    if (EdgeLayer* layer = m_scene->edgeLayerItem()) layer->beginDrag(m_moving);
+}
+
+QPointF DragSession::offset() const
+{
+    const Root& root = m_roots.first();
+    return root.node->scenePos() - root.anchor;
+}
+
+void DragSession::applyFrame()
+{
+    if (!isActive()) return;
+    if (m_stale) collect();
+
+    const QPointF delta = offset();
+    for (const auto& carried : std::as_const(m_carried)) carried.first->setPos(carried.second + delta);
+    for (Connection* connection : std::as_const(m_crossing)) connection->updatePath();
+    if (EdgeLayer* layer = m_scene->edgeLayerItem()) layer->dragTo(delta);
+}
@@ -0,0 +1,193 @@
+#include "DurableWriter.h"
+#include <QtGlobal>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QDirIterator>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+namespace {
+// 把已写完的文件内容刷到磁盘
+bool syncFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) return false;
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#elif defined(Q_OS_LINUX)
+    // 只需要内容落盘，不必等文件时间等元数据
+    return ::fdatasync(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+// 写完一个临时文件就开始回写，后面逐个刷盘时大部分数据已在路上
+void startWriteback(int handle)
+{
+#ifdef Q_OS_LINUX
+    ::sync_file_range(handle, 0, 0, SYNC_FILE_RANGE_WRITE);
+#else
+    Q_UNUSED(handle);
+#endif
+}
+
+bool replaceFile(const QString& from, const QString& to)
+{
+    // 同一文件系统内改名是原子的，目标已存在时直接替换
+#ifdef Q_OS_WIN
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(from.utf16()), reinterpret_cast<const wchar_t*>(to.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+}
+
+DurableWriter::DurableWriter(Durability durability)
+    : m_durability(durability)
+{
+}
+
+DurableWriter::~DurableWriter()
+{
+    if (!m_files.isEmpty()) commit();
+}
+
+QString DurableWriter::tempPath(const QString& filePath)
+{
+    return filePath + QStringLiteral(".tmp");
+}
+
+void DurableWriter::add(const QString& filePath, const QByteArray& data)
+{
+    m_files.append({ filePath, data });
+}
+
+bool DurableWriter::writeDirect()
+{
+    bool ok = true;
+    for (const auto& file : std::as_const(m_files)) {
+        QFile out(file.first);
+        if (!out.open(QIODevice::WriteOnly) || out.write(file.second) != file.second.size()) {
+            qWarning() << "无法写入文件:" << file.first;
+            ok = false;
+        }
+    }
+    m_files.clear();
+    return ok;
+}
+
+bool DurableWriter::commit()
+{
+    if (m_files.isEmpty()) return true;
+    if (m_durability == Buffered) return writeDirect();
+
+    // 第一步：全部写到临时文件，暂不刷盘
+    QStringList temps;
+    temps.reserve(m_files.size());
+    for (const auto& file : std::as_const(m_files)) {
+        const QString temp = tempPath(file.first);
+        QFile out(temp);
+        if (!out.open(QIODevice::WriteOnly) || out.write(file.second) != file.second.size()) {
+            qWarning() << "无法写入临时文件:" << temp;
+            out.close();
+            temps.append(temp);
+            for (const QString& path : std::as_const(temps)) QFile::remove(path);
+            m_files.clear();
+            return false;
+        }
+        if (m_durability == Durable && out.flush()) startWriteback(out.handle());
+        temps.append(temp);
+    }
+
+    QStringList dirs;
+    {
+        QSet<QString> seen;
+        for (const auto& file : std::as_const(m_files)) {
+            const QString dir = QFileInfo(file.first).absolutePath();
+            if (!seen.contains(dir)) {
+                seen.insert(dir);
+                dirs.append(dir);
+            }
+        }
+    }
+
+    // 第二步：改名前整批刷盘，保证改名后看到的一定是完整内容；
+    // 刷盘失败时一个文件都不替换，整批放弃
+    if (m_durability == Durable && !syncGroup(temps, QStringList())) {
+        qWarning() << "临时文件刷盘失败，放弃本批写入";
+        for (const QString& path : std::as_const(temps)) QFile::remove(path);
+        m_files.clear();
+        return false;
+    }
+
+    // 第三步：逐个改名替换原文件。多个文件的改名无法合成一次原子操作，
+    // 某个改名失败时仍替换其余文件，让本批尽量完整，并返回 false；
+    // 调用方据此保留编辑日志并重试整批，而不是停在前半批已替换的状态
+    bool ok = true;
+    for (int i = 0; i < temps.size(); ++i) {
+        if (!replaceFile(temps[i], m_files[i].first)) {
+            qWarning() << "无法替换文件:" << m_files[i].first;
+            QFile::remove(temps[i]);
+            ok = false;
+        }
+    }
+
+    // 第四步：刷目录项，让改名本身落盘
+    if (m_durability == Durable && !syncGroup(QStringList(), dirs)) ok = false;
+
+    m_files.clear();
+    return ok;
+}
+
+bool DurableWriter::syncGroup(const QStringList& files, const QStringList& dirs)
+{
+    // 只刷本批的文件和目录，写回错误也能从各自的 fsync 得到
+    bool ok = true;
+    for (const QString& file : files) ok = syncFile(file) && ok;
+    for (const QString& dir : dirs) ok = syncDirectory(dir) && ok;
+    return ok;
+}
+
+bool DurableWriter::writeFile(const QString& filePath, const QByteArray& data, Durability durability)
+{
+    DurableWriter writer(durability);
+    writer.add(filePath, data);
+    return writer.commit();
+}
+
+bool DurableWriter::syncDirectory(const QString& dirPath)
+{
+#ifdef Q_OS_WIN
+    // NTFS 的目录项由文件系统日志保证，无法也无需单独刷写
+    Q_UNUSED(dirPath);
+    return true;
+#else
+    const int fd = ::open(QFile::encodeName(dirPath).constData(), O_RDONLY);
+    if (fd < 0) return false;
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+int DurableWriter::removeStaleTemps(const QString& rootPath)
+{
+    // 提交中途崩溃会留下没改名的临时文件，它们的内容已由编辑日志覆盖
+    int removed = 0;
+    QDirIterator it(rootPath, { QStringLiteral("*.tmp") }, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (QFile::remove(it.next())) ++removed;
+    }
+    return removed;
+}
@@ -0,0 +1,548 @@
+#include "EdgeLayer.h"
+#include "MindMapNode.h"
+#include "MindMapScene.h"
+#include "Connection.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+#include <utility>
+
+namespace {
+const qreal kCellSize = 256;        // 网格单元边长（场景坐标）
+const int kMaxCellsPerEdge = 16;    // 超过此数的连线放入长连线列表
+const qreal kFarDetail = 0.2;       // 缩得很小时画直线
+
+quint64 cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+void appendCurve(QPainterPath& path, const QPointF& start, const QPointF& end)
+{
+    const qreal dx = end.x() - start.x();
+    path.moveTo(start);
+    path.cubicTo(QPointF(start.x() + dx * 0.5, start.y()), QPointF(start.x() + dx * 0.5, end.y()), end);
+}
+}
+
+EdgeLayer::EdgeLayer(QGraphicsItem* parent)
+    : QGraphicsObject(parent), m_rebuildAll(false), m_frame(0), m_model(nullptr),
+      m_pen(Qt::darkGray, 2, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin)
+{
+    setZValue(-1); // 确保在节点下方
+    setAcceptedMouseButtons(Qt::NoButton);
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption); // 需要 exposedRect
+
+    m_rebuildTimer.setSingleShot(true);
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &EdgeLayer::refresh);
+}
+
+QRectF EdgeLayer::boundingRect() const
+{
+    return m_bounds;
+}
+
+QPainterPath EdgeLayer::shape() const
+{
+    return QPainterPath();
+}
+
+void EdgeLayer::markDirty()
+{
+    m_rebuildAll = true;
+    if (!m_rebuildTimer.isActive()) m_rebuildTimer.start(0);
+}
+
+void EdgeLayer::nodeChanged(const MindMapNode* node)
+{
+    if (m_model) return;
+    // 拖动中的连线不在网格里，拖动期间的其他变化留到重建时处理
+    if (!m_dragSet.isEmpty()) {
+        markDirty();
+        return;
+    }
+    m_pending.insert(node);
+    if (!m_rebuildTimer.isActive()) m_rebuildTimer.start(0);
+}
+
+void EdgeLayer::nodeRemoved(const MindMapNode* node)
+{
+    m_pending.remove(node);
+    m_dragSet.remove(node);
+    auto tree = m_treeEdges.find(node);
+    if (tree != m_treeEdges.end()) {
+        releaseEdge(tree.value());
+        m_treeEdges.erase(tree);
+    }
+    for (Connection* connection : node->connections()) linkRemoved(connection);
+    finishEdits();
+}
+
+void EdgeLayer::linkChanged(const Connection* connection)
+{
+    if (m_model) return;
+    if (!m_dragSet.isEmpty()) {
+        markDirty();
+        return;
+    }
+    syncLink(connection);
+    finishEdits();
+}
+
+void EdgeLayer::linkRemoved(const Connection* connection)
+{
+    auto link = m_linkEdges.find(connection);
+    if (link == m_linkEdges.end()) return;
+    releaseEdge(link.value());
+    m_linkEdges.erase(link);
+    finishEdits();
+}
+
+void EdgeLayer::refresh()
+{
+    if (m_rebuildAll) {
+        rebuild();
+        return;
+    }
+
+    const QSet<const MindMapNode*> pending = std::exchange(m_pending, {});
+    for (const MindMapNode* node : pending) {
+        // 祖先也待同步时随祖先一起处理
+        bool covered = false;
+        for (const MindMapNode* parent = node->parentNode(); parent && !covered; parent = parent->parentNode()) {
+            covered = pending.contains(parent);
+        }
+        if (!covered) syncSubtree(node, isShown(node));
+    }
+    finishEdits();
+}
+
+bool EdgeLayer::isShown(const MindMapNode* node) const
+{
+    // 与 collectEdges 一致：祖先全部展开的节点才会被收集
+    if (node->scene() != scene()) return false;
+    for (const MindMapNode* parent = node->parentNode(); parent; parent = parent->parentNode()) {
+        if (!parent->isExpanded()) return false;
+    }
+    return true;
+}
+
+void EdgeLayer::syncSubtree(const MindMapNode* node, bool shown)
+{
+    syncTreeEdge(node, shown);
+    for (Connection* connection : node->connections()) syncLink(connection);
+    const bool childrenShown = shown && node->isExpanded();
+    for (MindMapNode* child : node->children()) syncSubtree(child, childrenShown);
+}
+
+void EdgeLayer::syncTreeEdge(const MindMapNode* node, bool shown)
+{
+    // 根节点和折叠子树中的节点没有可见的父子连线
+    const MindMapNode* parent = node->parentNode();
+    auto tree = m_treeEdges.find(node);
+    if (!shown || !parent) {
+        if (tree == m_treeEdges.end()) return;
+        releaseEdge(tree.value());
+        m_treeEdges.erase(tree);
+        return;
+    }
+
+    const int index = placeEdge(tree != m_treeEdges.end() ? tree.value() : -1, parent->scenePos(), node->scenePos());
+    if (tree == m_treeEdges.end()) m_treeEdges.insert(node, index);
+}
+
+void EdgeLayer::syncLink(const Connection* connection)
+{
+    // 父子之间的连线由 syncTreeEdge 负责；终点被折叠隐藏时不画
+    const MindMapNode* source = connection->sourceNode();
+    const MindMapNode* destination = connection->destinationNode();
+    const bool shown = source && destination && destination->parentNode() != source
+        && destination->isVisible() && isShown(source);
+
+    auto link = m_linkEdges.find(connection);
+    if (!shown) {
+        if (link == m_linkEdges.end()) return;
+        releaseEdge(link.value());
+        m_linkEdges.erase(link);
+        return;
+    }
+
+    const int index = placeEdge(link != m_linkEdges.end() ? link.value() : -1, source->scenePos(), destination->scenePos());
+    if (link == m_linkEdges.end()) m_linkEdges.insert(connection, index);
+}
+
+int EdgeLayer::placeEdge(int index, const QPointF& from, const QPointF& to)
+{
+    // 新连线占一个空闲下标；已有的连线端点没变时什么也不做
+    if (index < 0) {
+        index = addEdge(from, to);
+    } else {
+        const Edge& edge = m_edges[index];
+        if (edge.from == from && edge.to == to) return index;
+        m_damage |= edge.bounds;
+        removeCells(index);
+        m_edges[index].from = from;
+        m_edges[index].to = to;
+        m_edges[index].bounds = QRectF(from, to).normalized();
+    }
+
+    // 包围盒只增不减，整体重建时再收紧
+    const QRectF& bounds = m_edges[index].bounds;
+    insertCells(index);
+    m_damage |= bounds;
+    m_staticBounds |= bounds;
+    return index;
+}
+
+void EdgeLayer::releaseEdge(int index)
+{
+    Edge& edge = m_edges[index];
+    if (!edge.live) return;
+    m_damage |= edge.bounds;
+
+    if (edge.moving == 0) {
+        removeCells(index);
+    } else if (edge.moving == 3) {
+        m_dragInside.removeOne(index);
+        m_dragPath = QPainterPath();
+        for (int i : std::as_const(m_dragInside)) appendCurve(m_dragPath, m_edges[i].from, m_edges[i].to);
+        update();
+    } else {
+        m_dragCrossing.removeOne(index);
+    }
+    edge.live = false;
+    edge.moving = 0;
+    m_free.append(index);
+}
+
+void EdgeLayer::insertCells(int index)
+{
+    const QRectF& box = m_edges[index].bounds;
+    const int x0 = qFloor(box.left() / kCellSize);
+    const int x1 = qFloor(box.right() / kCellSize);
+    const int y0 = qFloor(box.top() / kCellSize);
+    const int y1 = qFloor(box.bottom() / kCellSize);
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > kMaxCellsPerEdge) {
+        m_large.append(index);
+        return;
+    }
+    for (int x = x0; x <= x1; ++x) {
+        for (int y = y0; y <= y1; ++y) m_grid[cellKey(x, y)].append(index);
+    }
+}
+
+void EdgeLayer::removeCells(int index)
+{
+    // 按登记时的包围盒找到所在单元
+    const QRectF& box = m_edges[index].bounds;
+    const int x0 = qFloor(box.left() / kCellSize);
+    const int x1 = qFloor(box.right() / kCellSize);
+    const int y0 = qFloor(box.top() / kCellSize);
+    const int y1 = qFloor(box.bottom() / kCellSize);
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > kMaxCellsPerEdge) {
+        m_large.removeOne(index);
+        return;
+    }
+    for (int x = x0; x <= x1; ++x) {
+        for (int y = y0; y <= y1; ++y) {
+            auto cell = m_grid.find(cellKey(x, y));
+            if (cell == m_grid.end()) continue;
+            cell->removeOne(index);
+            if (cell->isEmpty()) m_grid.erase(cell);
+        }
+    }
+}
+
+void EdgeLayer::holdForDrag(int index, int moving)
+{
+    // 拖动中的连线不进网格，绘制时单独处理
+    Edge& edge = m_edges[index];
+    edge.moving = moving;
+    if (moving == 3) {
+        m_dragInside.append(index);
+        appendCurve(m_dragPath, edge.from, edge.to);
+    } else {
+        m_dragCrossing.append(index);
+    }
+}
+
+void EdgeLayer::finishEdits()
+{
+    updateBounds();
+    if (m_damage.isNull()) return;
+    const qreal margin = m_pen.widthF();
+    update(m_damage.adjusted(-margin, -margin, margin, margin));
+    m_damage = QRectF();
+}
+
+void EdgeLayer::rebuild()
+{
+    m_rebuildTimer.stop();
+    m_rebuildAll = false;
+    m_pending.clear();
+    m_edges.clear();
+    m_free.clear();
+    m_stamp.clear();
+    m_treeEdges.clear();
+    m_linkEdges.clear();
+    m_grid.clear();
+    m_large.clear();
+    m_damage = QRectF();
+    m_dragPath = QPainterPath();
+    m_dragInside.clear();
+    m_dragCrossing.clear();
+    m_dragBase = m_dragOffset;
+
+    MindMapScene* owner = qobject_cast<MindMapScene*>(scene());
+    if (m_model) {
+        collectModelEdges();
+    } else if (owner && owner->rootNode()) {
+        collectEdges(owner->rootNode());
+    }
+
+    QRectF bounds;
+    for (int i = 0; i < m_edges.size(); ++i) {
+        if (m_edges[i].moving) {
+            holdForDrag(i, m_edges[i].moving);
+            continue;
+        }
+        bounds |= m_edges[i].bounds;
+        insertCells(i);
+    }
+    m_frame = 0;
+    m_staticBounds = bounds;
+
+    updateBounds();
+    update();
+}
+
+void EdgeLayer::updateBounds()
+{
+    // 跨出集合的连线只移动一端，按当前端点重新求包围盒
+    const QPointF delta = dragDelta();
+    QRectF extent;
+    if (!m_dragPath.isEmpty()) extent = m_dragPath.controlPointRect().translated(delta);
+    for (int i : std::as_const(m_dragCrossing)) {
+        const Edge& edge = m_edges[i];
+        const QPointF from = edge.moving & 1 ? edge.from + delta : edge.from;
+        const QPointF to = edge.moving & 2 ? edge.to + delta : edge.to;
+        extent |= QRectF(from, to).normalized();
+    }
+
+    // 线宽超出端点包围盒的部分也要重绘
+    const qreal margin = m_pen.widthF();
+    m_dragExtent = extent.isNull() ? QRectF() : extent.adjusted(-margin, -margin, margin, margin);
+    QRectF bounds = (m_staticBounds | extent).adjusted(-margin, -margin, margin, margin);
+    if (bounds != m_bounds) {
+        prepareGeometryChange();
+        m_bounds = bounds;
+    }
+}
+
+void EdgeLayer::beginDrag(const QSet<const MindMapNode*>& moving)
+{
+    // 拖动中重新整理集合，或还有待整体重建的修改时，按集合重建
+    const bool rebuildAll = m_rebuildAll || !m_dragSet.isEmpty();
+    m_dragSet = moving;
+    m_dragOffset = QPointF();
+    if (rebuildAll) {
+        rebuild();
+        return;
+    }
+    refresh();
+
+    // 只把集合内节点的连线移出网格，其余连线不动
+    m_dragBase = QPointF();
+    m_dragPath = QPainterPath();
+    m_dragInside.clear();
+    m_dragCrossing.clear();
+    for (const MindMapNode* node : moving) {
+        auto tree = m_treeEdges.constFind(node);
+        if (tree != m_treeEdges.constEnd()) {
+            removeCells(tree.value());
+            holdForDrag(tree.value(), (moving.contains(node->parentNode()) ? 1 : 0) | 2);
+        }
+        for (Connection* connection : node->connections()) {
+            auto link = m_linkEdges.constFind(connection);
+            if (link == m_linkEdges.constEnd() || m_edges[link.value()].moving) continue;
+            removeCells(link.value());
+            holdForDrag(link.value(), (moving.contains(connection->sourceNode()) ? 1 : 0)
+                                      | (moving.contains(connection->destinationNode()) ? 2 : 0));
+        }
+    }
+    updateBounds();
+    update();
+}
+
+void EdgeLayer::dragTo(const QPointF& offset)
+{
+    if (m_dragSet.isEmpty() || offset == m_dragOffset) return;
+    // 只重绘拖动前后连线覆盖的区域
+    const QRectF before = m_dragExtent;
+    m_dragOffset = offset;
+    updateBounds();
+    update(before | m_dragExtent);
+}
+
+void EdgeLayer::endDrag()
+{
+    if (m_dragSet.isEmpty()) return;
+    const QSet<const MindMapNode*> moved = std::exchange(m_dragSet, {});
+    m_dragOffset = QPointF();
+    // 立即按最终位置更新，避免松开时闪回一帧
+    if (m_rebuildAll) {
+        rebuild();
+        return;
+    }
+
+    // 拖动的连线先按开始时的位置放回网格，再按最终位置同步
+    const QVector<int> held = m_dragInside + m_dragCrossing;
+    m_dragPath = QPainterPath();
+    m_dragInside.clear();
+    m_dragCrossing.clear();
+    m_dragBase = QPointF();
+    for (int i : held) {
+        m_edges[i].moving = 0;
+        insertCells(i);
+    }
+    for (const MindMapNode* node : moved) {
+        syncTreeEdge(node, isShown(node));
+        for (Connection* connection : node->connections()) syncLink(connection);
+    }
+    updateBounds();
+    update();
+    m_damage = QRectF();
+}
+
+void EdgeLayer::collectEdges(MindMapNode* node)
+{
+    // 折叠节点的子树不可见，不收集其中的连线
+    const QPointF from = node->scenePos();
+    const int moving = m_dragSet.contains(node) ? 1 : 0;
+    if (node->isExpanded()) {
+        for (MindMapNode* child : node->children()) {
+            m_treeEdges.insert(child, addEdge(from, child->scenePos(), moving | (m_dragSet.contains(child) ? 2 : 0)));
+            collectEdges(child);
+        }
+    }
+
+    // 非父子关系的连线由起点一侧负责收集
+    for (Connection* connection : node->connections()) {
+        MindMapNode* destination = connection->destinationNode();
+        if (connection->sourceNode() != node || !destination) continue;
+        if (destination->parentNode() == node || !destination->isVisible()) continue;
+        m_linkEdges.insert(connection, addEdge(from, destination->scenePos(), moving | (m_dragSet.contains(destination) ? 2 : 0)));
+    }
+}
+
+void EdgeLayer::collectModelEdges()
+{
+    // 每个可见节点连向父节点，位置已是场景坐标
+    for (int i = 1; i < m_model->size(); ++i) {
+        if (!m_model->isVisible(i)) continue;
+        addEdge(m_model->position(m_model->parent(i)), m_model->position(i));
+    }
+}
+
+int EdgeLayer::addEdge(const QPointF& from, const QPointF& to, int moving)
+{
+    // 曲线的控制点落在两端点之间，端点包围盒即曲线包围盒
+    Edge edge;
+    edge.from = from;
+    edge.to = to;
+    edge.bounds = QRectF(from, to).normalized();
+    edge.moving = moving;
+    if (!m_free.isEmpty()) {
+        const int index = m_free.takeLast();
+        m_edges[index] = edge;
+        return index;
+    }
+    m_edges.append(edge);
+    m_stamp.append(0);
+    return m_edges.size() - 1;
+}
+
+void EdgeLayer::collectVisible(const QRectF& exposed, QVector<int>& visible)
+{
+    if (++m_frame == 0) {
+        m_stamp.fill(0);
+        m_frame = 1;
+    }
+
+    auto take = [&](int i) {
+        if (m_stamp[i] == m_frame) return;
+        m_stamp[i] = m_frame;
+        if (m_edges[i].bounds.intersects(exposed) || m_edges[i].bounds.isEmpty()) visible.append(i);
+    };
+
+    const int x0 = qFloor(exposed.left() / kCellSize);
+    const int x1 = qFloor(exposed.right() / kCellSize);
+    const int y0 = qFloor(exposed.top() / kCellSize);
+    const int y1 = qFloor(exposed.bottom() / kCellSize);
+
+    if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) > m_grid.size()) {
+        // 暴露区域比已用单元还多时直接遍历已用单元
+        for (auto it = m_grid.cbegin(); it != m_grid.cend(); ++it) {
+            for (int i : it.value()) take(i);
+        }
+    } else {
+        for (int x = x0; x <= x1; ++x) {
+            for (int y = y0; y <= y1; ++y) {
+                auto cell = m_grid.constFind(cellKey(x, y));
+                if (cell == m_grid.constEnd()) continue;
+                for (int i : cell.value()) take(i);
+            }
+        }
+    }
+    for (int i : std::as_const(m_large)) take(i);
+}
+
+void EdgeLayer::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
+{
+    Q_UNUSED(widget);
+
+    const QRectF& exposed = option->exposedRect;
+    QVector<int> visible;
+    collectVisible(exposed, visible);
+
+    // 拖动中跨出集合的连线按当前偏移求端点
+    const QPointF delta = dragDelta();
+    QVector<QLineF> crossing;
+    crossing.reserve(m_dragCrossing.size());
+    for (int i : std::as_const(m_dragCrossing)) {
+        const Edge& edge = m_edges[i];
+        crossing.append(QLineF(edge.moving & 1 ? edge.from + delta : edge.from,
+                               edge.moving & 2 ? edge.to + delta : edge.to));
+    }
+    const bool dragVisible = !m_dragPath.isEmpty()
+        && m_dragPath.controlPointRect().translated(delta).intersects(exposed);
+    if (visible.isEmpty() && crossing.isEmpty() && !dragVisible) return;
+
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (lod < kFarDetail) {
+        // 缩得很小时曲线和直线看不出区别
+        QVector<QLineF> lines = crossing;
+        lines.reserve(lines.size() + visible.size());
+        for (int i : std::as_const(visible)) lines.append(QLineF(m_edges[i].from, m_edges[i].to));
+        painter->setPen(QPen(m_pen.color(), 0));
+        painter->drawLines(lines);
+    } else {
+        // 所有可见曲线合成一条路径，一次描边
+        QPainterPath path;
+        for (int i : std::as_const(visible)) appendCurve(path, m_edges[i].from, m_edges[i].to);
+        for (const QLineF& line : std::as_const(crossing)) appendCurve(path, line.p1(), line.p2());
+        painter->setPen(m_pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPath(path);
+    }
+
+    // 拖动集合内部的连线整体平移，不重建路径
+    if (dragVisible) {
+        painter->save();
+        painter->translate(delta);
+        painter->setBrush(Qt::NoBrush);
+        painter->drawPath(m_dragPath);
+        painter->restore();
+    }
+}
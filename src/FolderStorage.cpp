@@ -0,0 +1,89 @@
+#include "FolderStorage.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QDebug>
+
+FolderStorage::FolderStorage(const QString& rootPath)
+    : MapStorage(rootPath)
+{
+}
+
+bool FolderStorage::load(QList<NodeRecord>& records)
+{
+    QDir dir(m_rootPath);
+    if (!dir.exists()) return false;
+
+    NodeRecord root;
+    root.id = records.size();
+    root.name = dir.dirName();
+    root.path = m_rootPath;
+    root.json = readFile(m_rootPath);
+    records.append(root);
+
+    // 递归加载子节点
+    loadSubtree(root.id, records);
+    return true;
+}
+
+void FolderStorage::loadSubtree(int parentIndex, QList<NodeRecord>& records)
+{
+    QDir parentDir(records.at(parentIndex).path);
+    QFileInfoList entries = parentDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    records[parentIndex].hasChildren = !entries.isEmpty();
+
+    for (const QFileInfo& entry : entries) {
+        NodeRecord child;
+        child.id = records.size();
+        child.parent = records.at(parentIndex).id;
+        child.name = entry.fileName();
+        child.path = entry.absoluteFilePath();
+        child.json = readFile(child.path);
+        records.append(child);
+
+        loadSubtree(child.id, records);
+    }
+}
+
+QJsonObject FolderStorage::readNode(const QString& folderPath) const
+{
+    return readFile(folderPath);
+}
+
+QStringList FolderStorage::childNames(const QString& folderPath) const
+{
+    return QDir(folderPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+}
+
+bool FolderStorage::writeNodes(const QHash<QString, QJsonObject>& documents)
+{
+    DurableWriter writer(m_durability);
+    for (auto it = documents.cbegin(); it != documents.cend(); ++it) {
+        writer.add(QDir(it.key()).filePath("node.json"), QJsonDocument(it.value()).toJson());
+    }
+    if (writer.commit()) return true;
+    qWarning() << "部分节点文档写入失败";
+    return false;
+}
+
+QJsonObject FolderStorage::readFile(const QString& folderPath)
+{
+    QFile file(QDir(folderPath).filePath("node.json"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (doc.isNull() || !doc.isObject()) {
+        qWarning() << "无效的JSON文件:" << file.fileName();
+        return QJsonObject();
+    }
+    return doc.object();
+}
+
+bool FolderStorage::writeFile(const QString& folderPath, const QJsonObject& json,
+                              DurableWriter::Durability durability)
+{
+    return DurableWriter::writeFile(QDir(folderPath).filePath("node.json"), QJsonDocument(json).toJson(), durability);
+}
@@ -0,0 +1,86 @@
+#include "ItemPool.h"
+#include "MindMapNode.h"
+#include "Connection.h"
+#include <QGraphicsScene>
+
+ItemPool::ItemPool(int limit)
+    : m_limit(limit)
+{
+}
+
+ItemPool::~ItemPool()
+{
+    clear();
+}
+
+void ItemPool::clear()
+{
+    // 池中的图形项不在场景中，不会随场景清空，这里负责删除
+    qDeleteAll(m_nodes);
+    qDeleteAll(m_connections);
+    m_nodes.clear();
+    m_connections.clear();
+}
+
+void ItemPool::setLimit(int limit)
+{
+    m_limit = qMax(0, limit);
+    while (m_nodes.size() > m_limit) delete m_nodes.takeLast();
+    while (m_connections.size() > m_limit) delete m_connections.takeLast();
+}
+
+void ItemPool::detach(QGraphicsItem* item)
+{
+    // 先脱离父项再移出场景，离开场景时节点会通知场景清理引用
+    if (item->parentItem()) item->setParentItem(nullptr);
+    if (QGraphicsScene* scene = item->scene()) scene->removeItem(item);
+}
+
+MindMapNode* ItemPool::takeNode(const NodeRecord& record, QGraphicsItem* parent)
+{
+    if (m_nodes.isEmpty()) return new MindMapNode(record, parent);
+
+    MindMapNode* node = m_nodes.takeLast();
+    // 先挂到父项下再换绑，路径只存相对父节点的一段；
+    // 挂到已在场景中的父项下即进入场景，由 itemChange 通知场景
+    if (parent) node->setParentItem(parent);
+    node->rebind(record);
+    return node;
+}
+
+Connection* ItemPool::takeConnection(MindMapNode* source, MindMapNode* destination, QGraphicsItem* parent)
+{
+    if (m_connections.isEmpty()) return new Connection(source, destination, parent);
+
+    Connection* connection = m_connections.takeLast();
+    if (parent) connection->setParentItem(parent);
+    connection->rebind(source, destination);
+    return connection;
+}
+
+void ItemPool::recycle(MindMapNode* node)
+{
+    if (!node) return;
+    if (m_nodes.size() >= m_limit) {
+        delete node;
+        return;
+    }
+
+    node->setSelected(false);
+    detach(node);
+    node->unbind();
+    m_nodes.append(node);
+}
+
+void ItemPool::recycle(Connection* connection)
+{
+    if (!connection) return;
+    if (m_connections.size() >= m_limit) {
+        delete connection;
+        return;
+    }
+
+    connection->reset();
+    detach(connection);
+    m_connections.append(connection);
+}
@@ -0,0 +1,207 @@
+#include "LayoutEngine.h"
+#include "MindMapNode.h"
+#include "TidyTreeLayout.h"
+#include <algorithm>
+
+void LayoutEngine::layoutAll(MindMapNode* root)
+{
+    LayoutSnapshot flat = snapshot(root);
+    compute(flat);
+    apply(flat);
+}
+
+void LayoutEngine::setMode(LayoutMode mode)
+{
+    m_mode = mode;
+    m_rows.clear();
+    m_dirty.clear();
+}
+
+LayoutSnapshot LayoutEngine::snapshot(MindMapNode* root) const
+{
+    LayoutSnapshot flat;
+    flat.mode = m_mode;
+    if (!root) return flat;
+
+    // 显式栈先序遍历，折叠节点的子树不进入快照
+    QVector<int> lastChild;
+    QVector<QPair<MindMapNode*, int>> stack;
+    stack.append(qMakePair(root, -1));
+
+    while (!stack.isEmpty()) {
+        const QPair<MindMapNode*, int> top = stack.takeLast();
+        MindMapNode* node = top.first;
+        const int parent = top.second;
+        const int index = flat.nodes.size();
+        const QRectF rect = node->boundingRect();
+
+        flat.nodes.append(node);
+        flat.parent.append(parent);
+        flat.firstChild.append(-1);
+        flat.nextSibling.append(-1);
+        flat.width.append(float(rect.width()));
+        flat.height.append(float(rect.height()));
+        lastChild.append(-1);
+
+        if (parent >= 0) {
+            if (lastChild[parent] < 0) flat.firstChild[parent] = index;
+            else flat.nextSibling[lastChild[parent]] = index;
+            lastChild[parent] = index;
+        }
+
+        if (node->isExpanded()) {
+            const QList<MindMapNode*> children = node->children();
+            for (qsizetype i = children.size() - 1; i >= 0; --i) {
+                stack.append(qMakePair(children.at(i), index));
+            }
+        }
+    }
+    return flat;
+}
+
+void LayoutEngine::compute(LayoutSnapshot& flat)
+{
+    const int count = flat.size();
+    flat.rows.fill(1, count);
+    flat.pos.resize(count);
+
+    // 子项下标总大于父项，逆序一遍即可累加子树行数
+    for (int i = count - 1; i > 0; --i) {
+        flat.rows[flat.parent[i]] += flat.rows[i];
+    }
+
+    if (flat.mode != OutlineLayout) {
+        TidyTreeLayout(flat).run(flat.mode == BalancedLayout);
+        return;
+    }
+
+    // 顺序一遍，依次排布每个节点的子节点
+    for (int i = 0; i < count; ++i) {
+        int offset = 1;
+        for (int c = flat.firstChild[i]; c >= 0; c = flat.nextSibling[c]) {
+            flat.pos[c] = QPointF(kIndent, offset * kRowHeight);
+            offset += flat.rows[c];
+        }
+    }
+    if (count > 0) flat.pos[0] = QPointF(0, 0);
+}
+
+void LayoutEngine::apply(const LayoutSnapshot& flat)
+{
+    m_rows.clear();
+    m_dirty.clear();
+    m_rows.reserve(flat.size());
+
+    for (int i = 0; i < flat.size(); ++i) {
+        place(flat.nodes[i], flat.pos[i].x(), flat.pos[i].y());
+        m_rows.insert(flat.nodes[i], flat.rows[i]);
+    }
+}
+
+void LayoutEngine::invalidate(MindMapNode* node)
+{
+    if (node) m_dirty.insert(node);
+}
+
+bool LayoutEngine::update(MindMapNode* root)
+{
+    if (m_dirty.isEmpty() || !root) return true;
+    if (m_mode != OutlineLayout) return false;
+
+    // 大面积变化（全部展开等）时逐个处理不如重排一遍
+    if (m_dirty.size() * 4 > m_rows.size()) return false;
+
+    // 先处理深层节点，祖先重排时用到的子树行数已是最新
+    QList<MindMapNode*> dirty = m_dirty.values();
+    m_dirty.clear();
+    std::sort(dirty.begin(), dirty.end(), [](MindMapNode* a, MindMapNode* b) {
+        return depth(a) > depth(b);
+    });
+
+    for (MindMapNode* node : std::as_const(dirty)) {
+        const int before = m_rows.value(node, -1);
+        const int after = placeChildren(node);
+        // 未缓存的新节点由其父节点的失效负责
+        if (before >= 0 && after != before) propagate(node, after - before);
+    }
+    return true;
+}
+
+void LayoutEngine::forget(MindMapNode* node)
+{
+    m_rows.remove(node);
+    m_dirty.remove(node);
+}
+
+void LayoutEngine::clear()
+{
+    m_rows.clear();
+    m_dirty.clear();
+}
+
+int LayoutEngine::layoutSubtree(MindMapNode* node)
+{
+    int total = 1;
+    if (node->isExpanded()) {
+        for (MindMapNode* child : node->children()) {
+            place(child, kIndent, total * kRowHeight);
+            total += layoutSubtree(child);
+        }
+    }
+    m_rows.insert(node, total);
+    return total;
+}
+
+int LayoutEngine::placeChildren(MindMapNode* node)
+{
+    // 只重排直接子节点；已缓存的子树整体随子节点移动
+    int total = 1;
+    if (node->isExpanded()) {
+        for (MindMapNode* child : node->children()) {
+            place(child, kIndent, total * kRowHeight);
+            auto cached = m_rows.constFind(child);
+            total += cached != m_rows.constEnd() ? cached.value() : layoutSubtree(child);
+        }
+    }
+    m_rows.insert(node, total);
+    return total;
+}
+
+void LayoutEngine::propagate(MindMapNode* node, int delta)
+{
+    MindMapNode* child = node;
+    MindMapNode* parent = node->parentNode();
+
+    while (parent && delta != 0) {
+        // 折叠的祖先始终只占一行，变化到此为止
+        if (!parent->isExpanded()) break;
+
+        auto rows = m_rows.find(parent);
+        if (rows == m_rows.end()) break; // 祖先尚未缓存，等待其自身失效时处理
+        rows.value() += delta;
+
+        // 平移其后的兄弟子树
+        bool after = false;
+        for (MindMapNode* sibling : parent->children()) {
+            if (after) place(sibling, sibling->pos().x(), sibling->pos().y() + delta * kRowHeight);
+            if (sibling == child) after = true;
+        }
+
+        child = parent;
+        parent = parent->parentNode();
+    }
+}
+
+void LayoutEngine::place(MindMapNode* node, qreal x, qreal y)
+{
+    // 位置未变时不触发保存；批量更新期间由场景跳过逐个保存
+    const QPointF target(x, y);
+    if (node->pos() != target) node->setPos(target);
+}
+
+int LayoutEngine::depth(const MindMapNode* node)
+{
+    int result = 0;
+    for (const MindMapNode* p = node->parentNode(); p; p = p->parentNode()) ++result;
+    return result;
+}
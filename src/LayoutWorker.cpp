@@ -0,0 +1,39 @@
+#include "LayoutWorker.h"
+#include "LayoutEngine.h"
+#include <QMetaObject>
+
+LayoutWorker::LayoutWorker(QObject* parent)
+    : QObject(parent), m_ticket(0), m_running(false)
+{
+    // 同一时间只算一份布局，后来的请求排队
+    m_pool.setMaxThreadCount(1);
+}
+
+LayoutWorker::~LayoutWorker()
+{
+    abort();
+    m_pool.waitForDone();
+}
+
+void LayoutWorker::start(const LayoutSnapshot& snapshot)
+{
+    const int ticket = ++m_ticket;
+    m_running = true;
+
+    m_pool.start([this, snapshot, ticket]() mutable {
+        LayoutEngine::compute(snapshot);
+
+        // 回到GUI线程交付；期间又有新请求时丢弃
+        QMetaObject::invokeMethod(this, [this, snapshot, ticket]() {
+            if (ticket != m_ticket) return;
+            m_running = false;
+            emit finished(snapshot);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LayoutWorker::abort()
+{
+    ++m_ticket;
+    m_running = false;
+}
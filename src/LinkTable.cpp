@@ -0,0 +1,241 @@
+#include "LinkTable.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QJsonArray>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = { 'M', 'M', 'L', 'K' };
+const quint32 kVersion = 1;
+
+// 计数排序：按 node 分组写出连线下标，start 为各组的起始偏移
+template <typename NodeOf>
+void buildGroups(int nodeCount, int linkCount, NodeOf nodeOf, QVector<int>& start, QVector<int>& links)
+{
+    start.fill(0, nodeCount + 1);
+    for (int i = 0; i < linkCount; ++i) ++start[nodeOf(i) + 1];
+    for (int n = 0; n < nodeCount; ++n) start[n + 1] += start[n];
+
+    QVector<int> next(start.cbegin(), start.cend() - 1);
+    links.resize(linkCount);
+    for (int i = 0; i < linkCount; ++i) links[next[nodeOf(i)]++] = i;
+}
+}
+
+void LinkTable::reset(const QString& rootPath)
+{
+    m_rootPath = rootPath;
+    m_nodes = SymbolTable();
+    m_links.clear();
+    m_keys.clear();
+    m_adjacencyValid = false;
+    m_complete = false;
+    m_modified = false;
+}
+
+QString LinkTable::relativePath(const QString& folderPath) const
+{
+    QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    if (rel == ".") rel.clear();
+    return rel;
+}
+
+QString LinkTable::absolutePath(const QString& rel) const
+{
+    return rel.isEmpty() ? m_rootPath : QDir(m_rootPath).filePath(rel);
+}
+
+bool LinkTable::load()
+{
+    QFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    char magic[4];
+    quint32 version = 0;
+    if (in.readRawData(magic, 4) != 4 || memcmp(magic, kMagic, 4) != 0) return false;
+    in >> version;
+    if (version != kVersion) return false;
+
+    QVector<QString> paths;
+    quint32 count = 0;
+    in >> paths >> count;
+    if (in.status() != QDataStream::Ok) return false;
+
+    QVector<Link> links;
+    links.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        Link link;
+        in >> link.source >> link.destination;
+        if (link.source >= quint32(paths.size()) || link.destination >= quint32(paths.size())) return false;
+        links.append(link);
+    }
+    if (in.status() != QDataStream::Ok) return false;
+
+    m_nodes = SymbolTable();
+    for (const QString& path : std::as_const(paths)) m_nodes.id(path);
+    m_links = links;
+    m_keys.clear();
+    m_keys.reserve(links.size());
+    for (const Link& link : std::as_const(m_links)) m_keys.insert(key(link.source, link.destination));
+    m_adjacencyValid = false;
+    m_complete = true;
+    m_modified = false;
+    return true;
+}
+
+bool LinkTable::save()
+{
+    if (!m_modified || !m_complete || m_rootPath.isEmpty()) return true;
+
+    // 只写出仍被连线引用的节点，顺带压缩编号
+    QVector<int> remap(m_nodes.size(), -1);
+    QVector<QString> paths;
+    auto mapped = [&](quint32 id) {
+        if (remap[id] < 0) {
+            remap[id] = paths.size();
+            paths.append(m_nodes.name(int(id)));
+        }
+        return quint32(remap[id]);
+    };
+    QVector<Link> links;
+    links.reserve(m_links.size());
+    for (const Link& link : std::as_const(m_links)) {
+        const quint32 source = mapped(link.source);
+        links.append({ source, mapped(link.destination) });
+    }
+
+    // 先写临时文件再替换，写到一半崩溃不会留下损坏的连线表
+    QSaveFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.writeRawData(kMagic, 4);
+    out << kVersion << paths << quint32(links.size());
+    for (const Link& link : std::as_const(links)) out << link.source << link.destination;
+    if (!file.commit()) return false;
+
+    m_modified = false;
+    return true;
+}
+
+void LinkTable::rebuild(const QList<NodeRecord>& records)
+{
+    reset(m_rootPath);
+    for (const NodeRecord& record : records) addRecord(record);
+    m_complete = true;
+    m_modified = true;
+}
+
+void LinkTable::addRecord(const NodeRecord& record)
+{
+    const QJsonArray targets = record.json["connections"].toArray();
+    if (targets.isEmpty()) return;
+
+    // 旧版本把到子节点的父子连线也写在这里，以文档中的子节点列表识别；
+    // ".." 之类不含斜杠的相对路径仍是跨节点连线
+    QSet<QString> children;
+    for (const QLatin1String field : { QLatin1String("children"), QLatin1String("hiddenChildren") }) {
+        const QJsonArray names = record.json.value(field).toArray();
+        for (const QJsonValue& name : names) children.insert(name.toString());
+    }
+
+    const QDir dir(record.path);
+    for (const QJsonValue& target : targets) {
+        const QString rel = target.toString();
+        if (rel.isEmpty() || children.contains(rel)) continue;
+        add(record.path, QDir::cleanPath(dir.filePath(rel)));
+    }
+}
+
+void LinkTable::insert(quint32 source, quint32 destination)
+{
+    m_links.append({ source, destination });
+    m_keys.insert(key(source, destination));
+    m_adjacencyValid = false;
+    m_modified = true;
+}
+
+bool LinkTable::add(const QString& sourcePath, const QString& destinationPath)
+{
+    const quint32 source = quint32(m_nodes.id(relativePath(sourcePath)));
+    const quint32 destination = quint32(m_nodes.id(relativePath(destinationPath)));
+    if (source == destination || m_keys.contains(key(source, destination))) return false;
+    insert(source, destination);
+    return true;
+}
+
+void LinkTable::removeAt(int index)
+{
+    // 与末尾交换后删除，不移动其余连线
+    m_keys.remove(key(m_links[index].source, m_links[index].destination));
+    m_links[index] = m_links.last();
+    m_links.removeLast();
+    m_adjacencyValid = false;
+    m_modified = true;
+}
+
+bool LinkTable::remove(const QString& sourcePath, const QString& destinationPath)
+{
+    const int source = m_nodes.find(relativePath(sourcePath));
+    const int destination = m_nodes.find(relativePath(destinationPath));
+    if (source < 0 || destination < 0 || !m_keys.contains(key(source, destination))) return false;
+
+    for (int i : outgoing(source)) {
+        if (m_links[i].destination == quint32(destination)) {
+            removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LinkTable::removeTree(const QString& folderPath)
+{
+    // 先逐个节点判断是否在子树中，再一遍过滤连线
+    const QString rel = relativePath(folderPath);
+    const QString prefix = rel + '/';
+    QVector<bool> removed(m_nodes.size(), false);
+    for (int id = 0; id < m_nodes.size(); ++id) {
+        const QString path = m_nodes.name(id);
+        removed[id] = path == rel || path.startsWith(prefix);
+    }
+
+    const qsizetype before = m_links.size();
+    m_links.erase(std::remove_if(m_links.begin(), m_links.end(), [&](const Link& link) {
+        if (!removed[link.source] && !removed[link.destination]) return false;
+        m_keys.remove(key(link.source, link.destination));
+        return true;
+    }), m_links.end());
+    if (m_links.size() == before) return;
+    m_adjacencyValid = false;
+    m_modified = true;
+}
+
+void LinkTable::buildAdjacency() const
+{
+    if (m_adjacencyValid) return;
+    const int nodes = m_nodes.size();
+    const int links = m_links.size();
+    buildGroups(nodes, links, [this](int i) { return int(m_links[i].source); }, m_outStart, m_outLinks);
+    buildGroups(nodes, links, [this](int i) { return int(m_links[i].destination); }, m_inStart, m_inLinks);
+    m_adjacencyValid = true;
+}
+
+QVector<int> LinkTable::outgoing(int id) const
+{
+    if (id < 0 || id >= m_nodes.size()) return QVector<int>();
+    buildAdjacency();
+    return QVector<int>(m_outLinks.cbegin() + m_outStart[id], m_outLinks.cbegin() + m_outStart[id + 1]);
+}
+
+QVector<int> LinkTable::incoming(int id) const
+{
+    if (id < 0 || id >= m_nodes.size()) return QVector<int>();
+    buildAdjacency();
+    return QVector<int>(m_inLinks.cbegin() + m_inStart[id], m_inLinks.cbegin() + m_inStart[id + 1]);
+}
@@ -0,0 +1,227 @@
+#include "MapJournal.h"
+#include "MapStorage.h"
+#include "DurableWriter.h"
+#include <QtGlobal>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+MapJournal::MapJournal(const QString& rootPath)
+    : m_rootPath(rootPath), m_base(0)
+{
+}
+
+MapJournal::~MapJournal()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) m_file.close();
+}
+
+QString MapJournal::filePath() const
+{
+    return QDir(m_rootPath).filePath(fileName());
+}
+
+bool MapJournal::needsRecovery() const
+{
+    return QFileInfo(filePath()).size() > 0;
+}
+
+int MapJournal::replay(MapStorage& storage)
+{
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly)) return 0;
+
+    const QDir root(m_rootPath);
+    QHash<QString, QJsonObject> documents; // 文件夹绝对路径 -> 回放后的文档
+
+    // 取回文档的引用只在单条操作内使用，插入新文档可能使旧引用失效
+    auto document = [&](const QString& path) -> QJsonObject& {
+        auto it = documents.find(path);
+        if (it == documents.end()) it = documents.insert(path, storage.readNode(path));
+        return it.value();
+    };
+
+    int count = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty()) continue;
+
+        // 崩溃时写了一半的末行无法解析，直接跳过
+        QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (!doc.isObject()) continue;
+
+        const QJsonObject entry = doc.object();
+        const QString op = entry["op"].toString();
+        const QString rel = entry["node"].toString();
+        const QString path = rel.isEmpty() ? m_rootPath : root.filePath(rel);
+        const QJsonValue value = entry["value"];
+
+        if (op == "text" || op == "color") {
+            document(path)[op] = value;
+        }
+        else if (op == "tag") {
+            QJsonObject& json = document(path);
+            QJsonArray tags = json["tags"].toArray();
+            tags.append(value);
+            json["tags"] = tags;
+        }
+        else if (op == "untag") {
+            QJsonObject& json = document(path);
+            QJsonArray tags = json["tags"].toArray();
+            for (qsizetype i = tags.size() - 1; i >= 0; --i) {
+                if (tags.at(i) == value) tags.removeAt(i);
+            }
+            json["tags"] = tags;
+        }
+        else if (op == "pos") {
+            QJsonObject& json = document(path);
+            const QJsonArray xy = value.toArray();
+            json["position_x"] = xy.at(0);
+            json["position_y"] = xy.at(1);
+        }
+        else if (op == "addChild") {
+            const QString name = value.toString();
+            QDir(path).mkpath(name);
+            {
+                QJsonObject& json = document(path);
+                QJsonArray children = json["children"].toArray();
+                if (!children.contains(name)) children.append(name);
+                json["children"] = children;
+            }
+            QJsonObject& child = document(QDir(path).filePath(name));
+            if (child.isEmpty()) child["text"] = name;
+        }
+        else if (op == "removeChild") {
+            const QString name = value.toString();
+            {
+                QJsonObject& json = document(path);
+                QJsonArray children = json["children"].toArray();
+                for (qsizetype i = children.size() - 1; i >= 0; --i) {
+                    if (children.at(i).toString() == name) children.removeAt(i);
+                }
+                json["children"] = children;
+            }
+
+            const QString childPath = QDir(path).filePath(name);
+            const QString prefix = childPath + '/';
+            for (auto it = documents.begin(); it != documents.end();) {
+                if (it.key() == childPath || it.key().startsWith(prefix)) {
+                    it = documents.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            storage.removeTree(childPath);
+            QDir(childPath).removeRecursively();
+        }
+        else {
+            qWarning() << "未知的日志操作:" << op;
+            continue;
+        }
+        ++count;
+    }
+    file.close();
+
+    // 没有完整写入时保留日志，下次打开再回放
+    if (!storage.writeNodes(documents) || !storage.sync()) {
+        qWarning() << "编辑日志回放后写入失败，保留日志:" << filePath();
+        return -1;
+    }
+
+    // 已合并进节点文件，清空日志
+    QFile::resize(filePath(), 0);
+    return count;
+}
+
+bool MapJournal::open()
+{
+    QMutexLocker locker(&m_mutex);
+    m_file.setFileName(filePath());
+    m_base = 0;
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qWarning() << "无法打开编辑日志:" << m_file.fileName();
+        return false;
+    }
+    return true;
+}
+
+void MapJournal::append(const QString& op, const QString& folderPath, const QJsonValue& value)
+{
+    QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    if (rel == ".") rel.clear();
+
+    QJsonObject entry;
+    entry["op"] = op;
+    entry["node"] = rel;
+    entry["value"] = value;
+    const QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n';
+
+    // 每次修改只是一小段追加，交给系统缓冲，由 sync 统一刷盘
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) return;
+    m_file.write(line);
+    m_file.flush();
+}
+
+qint64 MapJournal::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_base + (m_file.isOpen() ? m_file.size() : 0);
+}
+
+void MapJournal::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) return;
+
+    m_file.flush();
+#ifdef Q_OS_WIN
+    _commit(m_file.handle());
+#else
+    ::fsync(m_file.handle());
+#endif
+}
+
+void MapJournal::compact(qint64 checkpoint)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) return;
+
+    // checkpoint 是逻辑偏移，m_base 记录此前已丢弃的字节数
+    const qint64 fileSize = m_file.size();
+    const qint64 drop = qBound<qint64>(0, checkpoint - m_base, fileSize);
+    if (drop == 0) return;
+
+    // 全部记录都已写入节点文件时直接截断，崩溃也只会丢掉不再需要的记录
+    if (drop == fileSize) {
+        m_file.resize(0);
+        m_base += drop;
+        return;
+    }
+
+    // 还有未合并的记录：不能原地改写（截断后、写回前崩溃就丢了），
+    // 先把剩余部分持久写到临时文件，再改名替换日志
+    m_file.flush();
+    m_file.seek(drop);
+    const QByteArray tail = m_file.read(fileSize - drop);
+    m_file.close();
+    const bool replaced = DurableWriter::writeFile(filePath(), tail, DurableWriter::Durable);
+    if (!replaced) qWarning() << "无法整理编辑日志，保留原日志:" << filePath();
+
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qWarning() << "无法重新打开编辑日志:" << m_file.fileName();
+    }
+    if (replaced) m_base += drop;
+}
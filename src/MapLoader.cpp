@@ -0,0 +1,206 @@
+#include "MapLoader.h"
+#include "FolderStorage.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QMutexLocker>
+#include <QSet>
+
+namespace {
+const int kBatchSize = 2000;      // 每次交给场景的最大记录数
+const int kDrainInterval = 16;    // 约一帧
+}
+
+MapLoader::MapLoader(QObject* parent)
+    : QObject(parent), m_running(false), m_delivered(0)
+{
+    // 读目录和文件以等待IO为主，线程数多于核心数才能在网络盘上跑满
+    m_pool.setMaxThreadCount(QThread::idealThreadCount() * 2);
+
+    m_drainTimer.setInterval(kDrainInterval);
+    connect(&m_drainTimer, &QTimer::timeout, this, &MapLoader::drain);
+}
+
+MapLoader::~MapLoader()
+{
+    // 任务仍会访问线程池和本对象，析构前必须等它们结束
+    abort();
+    m_pool.waitForDone();
+}
+
+void MapLoader::start(const QSharedPointer<MapStorage>& storage, bool lazy)
+{
+    abort();
+
+    QSharedPointer<Run> run(new Run);
+    run->lazy = lazy;
+    run->nextId.storeRelaxed(1);
+    run->activeTasks.storeRelaxed(1);
+    m_run = run;
+    m_running = true;
+    m_delivered = 0;
+
+    if (storage->format() == MapStorage::FolderFormat) {
+        // 文件夹格式：每个目录一个任务，子目录继续派发
+        const QString root = storage->rootPath();
+        m_pool.start([this, run, root]() { scanFolder(run, 0, -1, QDir(root).dirName(), root); });
+    } else {
+        // 打包格式：一次映射读取即可，放到后台避免阻塞界面
+        m_pool.start([this, run, storage]() { loadAll(run, storage); });
+    }
+
+    m_drainTimer.start();
+}
+
+void MapLoader::cancel()
+{
+    if (!m_running) return;
+    m_run->canceled = true;
+}
+
+void MapLoader::abort()
+{
+    // 进行中的任务看到取消标记后尽快结束，写出的记录留在旧的状态里，不再交给场景
+    if (m_run) m_run->canceled = true;
+    m_run.reset();
+    m_generation.ref();
+    m_drainTimer.stop();
+    m_running = false;
+}
+
+void MapLoader::buildIndexes(const QSharedPointer<MapStorage>& storage, bool tags, bool search, bool links)
+{
+    const int generation = m_generation.loadRelaxed();
+    m_pool.start([this, storage, tags, search, links, generation]() {
+        if (generation != m_generation.loadRelaxed()) return;
+        QList<NodeRecord> records;
+        const bool loaded = storage->load(records);
+
+        // 读取失败时交出空结果，场景据此结束等待
+        QSharedPointer<MapIndexes> indexes(new MapIndexes);
+        if (loaded && tags) {
+            indexes->tags.reset(storage->rootPath());
+            indexes->tags.rebuild(records);
+            indexes->hasTags = true;
+        }
+        if (loaded && search) {
+            indexes->search.reset(storage->rootPath());
+            indexes->search.rebuild(records);
+            indexes->hasSearch = true;
+        }
+        if (loaded && links) {
+            indexes->links.reset(storage->rootPath());
+            indexes->links.rebuild(records);
+            indexes->hasLinks = true;
+        }
+
+        // 回到GUI线程交出；期间换了图或中止过则丢弃
+        QMetaObject::invokeMethod(this, [this, indexes, generation]() {
+            if (generation == m_generation.loadRelaxed()) emit indexesReady(indexes);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MapLoader::scanFolder(const QSharedPointer<Run>& run, int id, int parentId, const QString& name,
+                           const QString& path)
+{
+    if (!run->canceled) {
+        NodeRecord record;
+        record.id = id;
+        record.parent = parentId;
+        record.name = name;
+        record.path = path;
+        record.json = FolderStorage::readFile(path);
+        record.hash = MapStorage::contentHash(record.json);
+
+        QFileInfoList entries = QDir(path).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+        record.hasChildren = !entries.isEmpty();
+
+        // 折叠节点的子树留在磁盘上，展开时再加载
+        if (run->lazy && !record.json["expanded"].toBool()) entries.clear();
+
+        // 先交出本节点再派发子目录，保证父记录先于子记录
+        {
+            QMutexLocker locker(&run->mutex);
+            run->pending.append(record);
+        }
+
+        for (const QFileInfo& entry : entries) {
+            if (run->canceled) break;
+            const int childId = run->nextId.fetchAndAddRelaxed(1);
+            const QString childName = entry.fileName();
+            const QString childPath = entry.absoluteFilePath();
+            run->activeTasks.ref();
+            m_pool.start([this, run, childId, id, childName, childPath]() {
+                scanFolder(run, childId, id, childName, childPath);
+            });
+        }
+    }
+    run->activeTasks.deref();
+}
+
+void MapLoader::loadAll(const QSharedPointer<Run>& run, const QSharedPointer<MapStorage>& storage)
+{
+    if (!run->canceled) {
+        QList<NodeRecord> records;
+        if (storage->load(records)) {
+            // 只交出祖先全部展开的记录
+            if (run->lazy) {
+                QSet<int> expanded;
+                QList<NodeRecord> visible;
+                for (const NodeRecord& record : std::as_const(records)) {
+                    if (record.parent >= 0 && !expanded.contains(record.parent)) continue;
+                    if (record.json["expanded"].toBool()) expanded.insert(record.id);
+                    visible.append(record);
+                }
+                records.swap(visible);
+            }
+            // 散列在工作线程算好，保存时用来跳过没有变化的节点
+            for (NodeRecord& record : records) record.hash = MapStorage::contentHash(record.json);
+            QMutexLocker locker(&run->mutex);
+            run->pending.append(records);
+        } else {
+            run->failed = true;
+        }
+    }
+    run->activeTasks.deref();
+}
+
+void MapLoader::drain()
+{
+    // 持有一份引用：交出记录时场景可能中止这次加载（例如打开另一张图）
+    const QSharedPointer<Run> run = m_run;
+    if (!run) return;
+    const bool done = run->activeTasks.loadAcquire() == 0;
+
+    QList<NodeRecord> batch;
+    {
+        QMutexLocker locker(&run->mutex);
+        if (run->canceled) {
+            run->pending.clear();
+        } else if (run->pending.size() <= kBatchSize) {
+            batch.swap(run->pending);
+        } else {
+            batch = run->pending.mid(0, kBatchSize);
+            run->pending.remove(0, kBatchSize);
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        m_delivered += batch.size();
+        emit recordsReady(batch);
+        emit progress(m_delivered);
+        if (m_run != run) return;
+    }
+
+    // 所有任务结束且记录已全部交出
+    if (done) {
+        QMutexLocker locker(&run->mutex);
+        if (!run->pending.isEmpty()) return;
+        locker.unlock();
+
+        m_drainTimer.stop();
+        m_running = false;
+        emit finished(!run->canceled && !run->failed && m_delivered > 0);
+    }
+}
@@ -0,0 +1,287 @@
+#include "MapModel.h"
+#include "ColorPalette.h"
+#include "SymbolTable.h"
+#include <QApplication>
+#include <QFontMetrics>
+#include <QDir>
+#include <QJsonArray>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+const qreal kCellSize = 512;     // 网格单元边长（场景坐标）
+const qreal kNodeMargin = 400;   // 查询时外扩，覆盖以中心登记的节点的宽度
+
+quint64 cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+// 模型单独保存或由结构生成的字段，其余字段原样留在 m_extra 中
+const char* const kModelFields[] = {
+    "text", "color", "expanded", "position_x", "position_y", "path", "tags", "connections", "children"
+};
+
+QJsonObject extraFields(QJsonObject json)
+{
+    for (const char* field : kModelFields) json.remove(QLatin1String(field));
+    const QJsonValue hidden = json.value(QLatin1String("hiddenChildren"));
+    if (hidden.isArray() && hidden.toArray().isEmpty()) json.remove(QLatin1String("hiddenChildren"));
+    return json;
+}
+}
+
+MapModel::MapModel()
+    : m_version(0)
+{
+}
+
+void MapModel::clear()
+{
+    m_parent.clear();
+    m_firstChild.clear();
+    m_nextSibling.clear();
+    m_name.clear();
+    m_text.clear();
+    m_color.clear();
+    m_tags.clear();
+    m_extra.clear();
+    m_width.clear();
+    m_height.clear();
+    m_expanded.clear();
+    m_visible.clear();
+    m_pos.clear();
+    m_rootPath.clear();
+    m_recordIndex.clear();
+    m_grid.clear();
+    ++m_version;
+}
+
+void MapModel::append(const NodeRecord& record)
+{
+    const int parent = record.parent >= 0 ? m_recordIndex.value(record.parent, -1) : -1;
+    if (record.parent >= 0 && parent < 0) return;
+    if (record.parent < 0) m_rootPath = record.path;
+
+    m_recordIndex.insert(record.id, m_parent.size());
+    m_parent.append(parent);
+    m_firstChild.append(-1);
+    m_nextSibling.append(-1);
+    m_name.append(record.name);
+    m_text.append(record.json.contains("text") ? record.json["text"].toString() : record.name);
+    m_color.append(0);
+    m_expanded.append(record.json["expanded"].toBool());
+    m_visible.append(false);
+    m_pos.append(QPointF());
+    store(size() - 1, record.json);
+}
+
+void MapModel::finish()
+{
+    m_recordIndex.clear();
+    const int count = size();
+
+    // 按（父节点, 文件夹名）排序后相邻的同父节点即为兄弟，依次链接
+    QVector<int> order(count);
+    for (int i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        if (m_parent[a] != m_parent[b]) return m_parent[a] < m_parent[b];
+        return QString::compare(m_name[a], m_name[b], Qt::CaseInsensitive) < 0;
+    });
+
+    m_firstChild.fill(-1, count);
+    m_nextSibling.fill(-1, count);
+    for (int k = 0; k < count; ++k) {
+        const int i = order[k];
+        if (m_parent[i] < 0) continue;
+        if (k == 0 || m_parent[order[k - 1]] != m_parent[i]) m_firstChild[m_parent[i]] = i;
+        else m_nextSibling[order[k - 1]] = i;
+    }
+
+    m_width.resize(count);
+    m_height.resize(count);
+    const QFontMetrics fm(QApplication::font());
+    for (int i = 0; i < count; ++i) measure(i, fm);
+    ++m_version;
+}
+
+void MapModel::measure(int index, const QFontMetrics& fm)
+{
+    // 与 MindMapNode 的包围盒一致
+    m_width[index] = fm.horizontalAdvance(m_text[index]) + 50;
+    m_height[index] = fm.height() + 20;
+}
+
+void MapModel::setText(int index, const QString& text)
+{
+    if (m_text[index] == text) return;
+    m_text[index] = text;
+    measure(index, QFontMetrics(QApplication::font()));
+    ++m_version;
+}
+
+QString MapModel::folderPath(int index) const
+{
+    // 路径不逐个保存，沿父链拼出
+    QStringList names;
+    for (int i = index; m_parent[i] >= 0; i = m_parent[i]) names.prepend(m_name[i]);
+    return names.isEmpty() ? m_rootPath : QDir(m_rootPath).filePath(names.join('/'));
+}
+
+int MapModel::find(const QString& folderPath) const
+{
+    if (size() == 0) return -1;
+    const QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    if (rel == ".") return 0;
+
+    // 逐段在兄弟链中查找
+    int index = 0;
+    for (const QString& name : rel.split('/', Qt::SkipEmptyParts)) {
+        int child = m_firstChild[index];
+        while (child >= 0 && m_name[child] != name) child = m_nextSibling[child];
+        if (child < 0) return -1;
+        index = child;
+    }
+    return index;
+}
+
+NodeRecord MapModel::record(int index) const
+{
+    NodeRecord record;
+    record.id = index;
+    record.name = m_name[index];
+    record.path = folderPath(index);
+    record.hasChildren = m_firstChild[index] >= 0;
+
+    QJsonObject json = m_extra.value(index);
+    json["text"] = m_text[index];
+    json["color"] = ColorPalette::color(m_color[index]).name();
+    json["expanded"] = m_expanded[index];
+    QJsonArray tags;
+    for (quint32 id : m_tags.value(index)) tags.append(SymbolTable::tags().name(int(id)));
+    json["tags"] = tags;
+    QJsonArray children;
+    for (int c = m_firstChild[index]; c >= 0; c = m_nextSibling[c]) children.append(m_name[c]);
+    json["children"] = children;
+    record.json = json;
+    return record;
+}
+
+void MapModel::store(int index, const QJsonObject& json)
+{
+    if (json.contains("text")) setText(index, json["text"].toString());
+    if (json.contains("expanded")) setExpanded(index, json["expanded"].toBool());
+    m_color[index] = json.contains("color") ? ColorPalette::index(QColor(json["color"].toString())) : 0;
+
+    QList<quint32> tags;
+    for (const QJsonValue& tag : json["tags"].toArray()) tags.append(quint32(SymbolTable::tags().id(tag.toString())));
+    std::sort(tags.begin(), tags.end());
+    if (tags.isEmpty()) m_tags.remove(index);
+    else m_tags.insert(index, tags);
+
+    const QJsonObject extra = extraFields(json);
+    if (extra.isEmpty()) m_extra.remove(index);
+    else m_extra.insert(index, extra);
+}
+
+void MapModel::setExpanded(int index, bool expanded)
+{
+    if (m_expanded[index] == expanded) return;
+    m_expanded[index] = expanded;
+    ++m_version;
+}
+
+void MapModel::setAllExpanded(bool expanded)
+{
+    m_expanded.fill(expanded);
+    ++m_version;
+}
+
+LayoutSnapshot MapModel::snapshot(LayoutMode mode) const
+{
+    LayoutSnapshot flat;
+    flat.mode = mode;
+    if (size() == 0) return flat;
+
+    // 与 LayoutEngine::snapshot 相同的先序遍历，只是数据来自模型
+    QVector<int> lastChild;
+    QVector<QPair<int, int>> stack;
+    stack.append(qMakePair(0, -1));
+
+    while (!stack.isEmpty()) {
+        const QPair<int, int> top = stack.takeLast();
+        const int node = top.first;
+        const int parent = top.second;
+        const int index = flat.source.size();
+
+        flat.source.append(node);
+        flat.parent.append(parent);
+        flat.firstChild.append(-1);
+        flat.nextSibling.append(-1);
+        flat.width.append(m_width[node]);
+        flat.height.append(m_height[node]);
+        lastChild.append(-1);
+
+        if (parent >= 0) {
+            if (lastChild[parent] < 0) flat.firstChild[parent] = index;
+            else flat.nextSibling[lastChild[parent]] = index;
+            lastChild[parent] = index;
+        }
+
+        if (m_expanded[node]) {
+            QVector<int> children;
+            for (int c = m_firstChild[node]; c >= 0; c = m_nextSibling[c]) children.append(c);
+            for (qsizetype i = children.size() - 1; i >= 0; --i) stack.append(qMakePair(children.at(i), index));
+        }
+    }
+    flat.generation = m_version;
+    return flat;
+}
+
+void MapModel::applyLayout(const LayoutSnapshot& flat)
+{
+    m_visible.fill(false);
+    m_grid.clear();
+
+    // 快照中的位置相对父节点，先序累加得到场景坐标
+    QVector<QPointF> absolute(flat.size());
+    for (int i = 0; i < flat.size(); ++i) {
+        const int parent = flat.parent[i];
+        absolute[i] = parent >= 0 ? absolute[parent] + flat.pos[i] : flat.pos[i];
+
+        const int node = flat.source[i];
+        m_pos[node] = absolute[i];
+        m_visible[node] = true;
+        m_grid[cellKey(qFloor(absolute[i].x() / kCellSize), qFloor(absolute[i].y() / kCellSize))].append(node);
+    }
+}
+
+QVector<int> MapModel::query(const QRectF& rect) const
+{
+    QVector<int> result;
+    const QRectF area = rect.adjusted(-kNodeMargin, -kNodeMargin, kNodeMargin, kNodeMargin);
+    const int x0 = qFloor(area.left() / kCellSize);
+    const int x1 = qFloor(area.right() / kCellSize);
+    const int y0 = qFloor(area.top() / kCellSize);
+    const int y1 = qFloor(area.bottom() / kCellSize);
+
+    auto visit = [&](const QVector<int>& cell) {
+        for (int node : cell) {
+            const QPointF& p = m_pos[node];
+            const QRectF box(p.x() - m_width[node] / 2, p.y() - m_height[node] / 2, m_width[node], m_height[node]);
+            if (box.intersects(rect)) result.append(node);
+        }
+    };
+
+    if (qint64(x1 - x0 + 1) * (y1 - y0 + 1) > m_grid.size()) {
+        for (auto it = m_grid.cbegin(); it != m_grid.cend(); ++it) visit(it.value());
+    } else {
+        for (int x = x0; x <= x1; ++x) {
+            for (int y = y0; y <= y1; ++y) {
+                auto cell = m_grid.constFind(cellKey(x, y));
+                if (cell != m_grid.constEnd()) visit(cell.value());
+            }
+        }
+    }
+    return result;
+}
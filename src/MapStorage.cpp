@@ -0,0 +1,63 @@
+#include "MapStorage.h"
+#include "FolderStorage.h"
+#include "PackedStorage.h"
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+
+MapStorage::Format MapStorage::detect(const QString& rootPath)
+{
+    if (QFile::exists(QDir(rootPath).filePath(PackedStorage::fileName()))) {
+        return PackedFormat;
+    }
+    return FolderFormat;
+}
+
+QSharedPointer<MapStorage> MapStorage::create(Format format, const QString& rootPath)
+{
+    if (format == PackedFormat) {
+        return QSharedPointer<MapStorage>(new PackedStorage(rootPath));
+    }
+    return QSharedPointer<MapStorage>(new FolderStorage(rootPath));
+}
+
+NodeRecord MapStorage::loadNode(const QString& folderPath) const
+{
+    NodeRecord record;
+    record.name = QDir(folderPath).dirName();
+    record.path = folderPath;
+    record.json = readNode(folderPath);
+    record.hash = contentHash(record.json);
+    record.hasChildren = !childNames(folderPath).isEmpty();
+    return record;
+}
+
+QList<NodeRecord> MapStorage::loadChildren(const QString& folderPath) const
+{
+    QList<NodeRecord> records;
+    const QDir dir(folderPath);
+    for (const QString& name : childNames(folderPath)) {
+        records.append(loadNode(dir.filePath(name)));
+    }
+    return records;
+}
+
+quint64 MapStorage::contentHash(const QJsonObject& json)
+{
+    // 对象的键有序，同样的内容总是得到同样的紧凑序列化结果
+    return quint64(qHash(QJsonDocument(json).toJson(QJsonDocument::Compact)));
+}
+
+int MapStorage::copy(MapStorage& from, MapStorage& to)
+{
+    QList<NodeRecord> records;
+    if (!from.load(records)) return -1;
+
+    QHash<QString, QJsonObject> documents;
+    documents.reserve(records.size());
+    for (const NodeRecord& record : std::as_const(records)) {
+        documents.insert(record.path, record.json);
+    }
+    if (!to.writeNodes(documents) || !to.compact()) return -1;
+    return documents.size();
+}
@@ -1,5 +1,13 @@
 #include "MindMapNode.h"
 #include "Connection.h"
+#include "MindMapScene.h"
+#include "SaveQueue.h"
+#include "FolderStorage.h"
+#include "NodeStyleCache.h"
+#include "DragSession.h"
+#include "ItemPool.h"
+#include "SymbolTable.h"
+#include "ColorPalette.h"
 #include <QApplication>
 #include <QPainter>
 #include <QFontMetrics>
@@ -13,19 +21,44 @@
 #include <QFile>
 #include <QDebug>
 #include <QDesktopServices>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// 细节层级阈值（视图缩放后一个场景单位对应的像素数）
+const qreal kFarDetail = 0.2;   // 低于此值只画纯色块
+const qreal kMidDetail = 0.5;   // 低于此值画简化外形，文字还看不清
+const qreal kDimmedOpacity = 0.25; // 标签筛选时不匹配节点的不透明度
+
+// 由成员状态生成的字段：文字、调色板下标、展开状态、位置、路径段和标签编号
+// 已经保存在成员中，内存文档不再重复保存，序列化时重新拼出
+const char* const kDerivedFields[] = {
+    "text", "color", "expanded", "position_x", "position_y", "path", "tags", "connections"
+};
+
+bool isDerivedField(const QString& key)
+{
+    for (const char* field : kDerivedFields) {
+        if (key == QLatin1String(field)) return true;
+    }
+    return false;
+}
+}
 
 MindMapNode::MindMapNode(const QString& text, const QString& path, QGraphicsItem* parent)
-    : QGraphicsItem(parent), m_text(text), m_folderPath(path), m_color(QColor(135, 206, 250)),
-      m_expanded(false), m_loading(false)
+    : QGraphicsItem(parent), m_text(text), m_colorIndex(0),
+      m_expanded(false), m_loading(false), m_hasUnloadedChildren(false), m_relativePath(false), m_dimmed(false), m_modelIndex(-1),
+      m_savedHash(0)
 {
+    assignPath(path);
     setFlag(QGraphicsItem::ItemIsMovable);
     setFlag(QGraphicsItem::ItemIsSelectable);
     setFlag(QGraphicsItem::ItemSendsGeometryChanges);
     setAcceptHoverEvents(true);
 
     // 确保文件夹存在
-    if (!m_folderPath.isEmpty()) {
-        QDir dir(m_folderPath);
+    if (!m_segment.isEmpty()) {
+        QDir dir(folderPath());
         dir.mkpath(".");
 
         // 如果JSON文件存在，则加载
@@ -38,45 +71,170 @@ MindMapNode::MindMapNode(const QString& text, const QString& path, QGraphicsItem
             saveToJson();
         }
     }
+
+    updateGeometry();
+
+    // 以父项构造时已在场景中，基类构造期间不会调用到本类的 itemChange
+    if (MindMapScene* owner = mindMapScene()) owner->nodeAdded(this);
 }
 
-MindMapNode::~MindMapNode() = default;
+MindMapNode::MindMapNode(const NodeRecord& record, QGraphicsItem* parent)
+    : QGraphicsItem(parent), m_text(record.name), m_colorIndex(0),
+      m_expanded(false), m_loading(true), m_hasUnloadedChildren(record.hasChildren), m_relativePath(false), m_dimmed(false), m_modelIndex(-1),
+      m_savedHash(record.hash)
+{
+    setFlag(QGraphicsItem::ItemIsMovable);
+    setFlag(QGraphicsItem::ItemIsSelectable);
+    setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+    setAcceptHoverEvents(true);
+
+    // 文档已由存储后端读出，不再访问磁盘
+    fromJson(record.json);
+    assignPath(record.path); // 以实际所在位置为准
+    m_loading = false;
+    updateGeometry();
+
+    if (MindMapScene* owner = mindMapScene()) owner->nodeAdded(this);
+}
+
+MindMapNode::~MindMapNode()
+{
+    // 通知场景，避免延迟写入队列等处留下悬空指针
+    if (MindMapScene* owner = mindMapScene()) owner->nodeRemoved(this);
+
+    // 连线不再指向本节点；不在场景中的连线（由连线层绘制）不会随场景清空，由先析构的一端释放
+    const QList<Connection*> connections = m_connections;
+    m_connections.clear();
+    for (Connection* connection : connections) {
+        connection->detach(this);
+        if (!connection->scene()) delete connection;
+    }
+}
 //{
     // 保存节点信息
     //saveToJson();
     //TO DO 保存位置信息
 //}
 
+void MindMapNode::rebind(const NodeRecord& record)
+{
+    // 池中的图形项没有子节点和连线，只需恢复构造时的状态并替换文档；
+    // 调用方先挂好父项，路径才能拆成相对父节点的一段
+    m_loading = true;
+    setPos(0, 0);
+    setVisible(true);
+    setSelected(false);
+    setZValue(0);
+    setOpacity(1.0);
+    setDimmed(false);
+    setFlag(QGraphicsItem::ItemIsMovable);
+    m_modelIndex = -1;
+    m_text = record.name;
+    m_colorIndex = 0;
+    m_expanded = false;
+    m_tags.clear();
+    fromJson(record.json);
+    assignPath(record.path);
+    m_hasUnloadedChildren = record.hasChildren;
+    m_savedHash = record.hash;
+    m_loading = false;
+    updateGeometry();
+
+    // 进入场景时还没有路径，换绑后再登记
+    if (MindMapScene* owner = mindMapScene()) owner->nodePathChanged(this);
+}
+
+void MindMapNode::unbind()
+{
+    m_segment.clear();
+    m_relativePath = false;
+}
+
 QRectF MindMapNode::boundingRect() const
 {
-    QFontMetrics fm(QApplication::font());
-    int width = fm.horizontalAdvance(m_text) + 50; // 增加空间给展开按钮
-    int height = fm.height() + 20;
-    return QRectF(-width/2, -height/2, width, height);
+    return m_boundingRect;
+}
+
+QFont MindMapNode::labelFont() const
+{
+    return scene() ? scene()->font() : QApplication::font();
+}
+
+void MindMapNode::updateGeometry()
+{
+    const QFont font = labelFont();
+    m_label.setTextFormat(Qt::PlainText);
+    m_label.setText(m_text);
+    m_label.prepare(QTransform(), font);
+
+    // 尺寸按背景缓存的档位取整，背景贴图与节点一样大
+    QFontMetrics fm(font);
+    const QSize size = NodeStyleCache::bucketSize(QSizeF(fm.horizontalAdvance(m_text) + 50, // 增加空间给展开按钮
+                                                         fm.height() + 20));
+    const int width = size.width();
+    const int height = size.height();
+    const QRectF rect(-width/2, -height/2, width, height);
+
+    // 包围盒变化前通知场景，保证索引和重绘区域正确
+    if (rect != m_boundingRect) {
+        prepareGeometryChange();
+        m_boundingRect = rect;
+    }
+    m_buttonRect = QRectF(rect.right() - 25, rect.center().y() - 8, 16, 16);
+
+    const QSizeF labelSize = m_label.size();
+    m_labelPos = QPointF(rect.center().x() - labelSize.width() / 2, rect.center().y() - labelSize.height() / 2);
+    update();
 }
 
 void MindMapNode::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
     Q_UNUSED(widget);
 
-    QRectF rect = boundingRect();
+    const QRectF& rect = m_boundingRect;
+    // 场景在绘制每个图形项前都会重设画笔的不透明度，这里的修改不会带到子节点
+    if (m_dimmed) painter->setOpacity(painter->opacity() * kDimmedOpacity);
 
-    // 根节点使用不同的颜色
-    QColor nodeColor = isRoot() ? QColor(255, 165, 0) : m_color;
+    // 根节点使用不同的颜色（虚拟化时图形项没有父项，以模型下标判断）
+    const bool root = m_modelIndex >= 0 ? m_modelIndex == 0 : isRoot();
+    QColor nodeColor = root ? QColor(255, 165, 0) : ColorPalette::color(m_colorIndex);
 
-    QLinearGradient gradient(rect.topLeft(), rect.bottomRight());
-    gradient.setColorAt(0, nodeColor.lighter(120));
-    gradient.setColorAt(1, nodeColor);
+    // 按缩放程度选择细节层级，缩得很小时不做渐变、圆角和文字排版
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (lod < kFarDetail) {
+        painter->fillRect(rect, isSelected() ? QColor(Qt::blue) : nodeColor);
+        return;
+    }
+    if (lod < kMidDetail) {
+        painter->setBrush(nodeColor);
+        painter->setPen(isSelected() ? QPen(Qt::blue, 2) : QPen(Qt::darkGray, 0));
+        painter->drawRect(rect);
+        return;
+    }
 
-    painter->setBrush(gradient);
-    painter->setPen(QPen(isSelected() ? Qt::blue : Qt::darkGray, isSelected() ? 2 : 1));
-    painter->drawRoundedRect(rect, 10, 10);
+    // 背景从共享缓存贴图，贴图与节点一样大，按自身尺寸画出不缩放；
+    // 放大查看时贴图会模糊，改用矢量绘制
+    const int state = isSelected() ? NodeStyleCache::Selected : NodeStyleCache::Normal;
+    MindMapScene* owner = mindMapScene();
+    QPixmap background;
+    if (owner && lod <= 1.0) {
+        background = owner->styleCache()->background(nodeColor, rect.size(), state,
+                                                     painter->device()->devicePixelRatioF());
+    }
+    if (!background.isNull()) painter->drawPixmap(rect.topLeft(), background);
+    else NodeStyleCache::paintBackground(painter, rect, nodeColor, state);
 
     painter->setPen(Qt::black);
-    painter->drawText(rect, Qt::AlignCenter, m_text);
+    painter->setFont(labelFont());
+    painter->drawStaticText(m_labelPos, m_label);
+
+    // 悬停高亮盖在文字之上，与贴图中的边框对齐
+    if (option->state & QStyle::State_MouseOver) {
+        NodeStyleCache::paintHover(painter, background.isNull() ? rect : rect.adjusted(1, 1, -1, -1));
+    }
 
-    // 如果有子节点，绘制展开/折叠按钮
-    if (!m_children.isEmpty()) {
+    // 如果有子节点（包括未加载的），绘制展开/折叠按钮
+    if (hasChildren()) {
         QRectF buttonRect = expandButtonRect();
         painter->setBrush(Qt::white);
         painter->drawRect(buttonRect);
@@ -90,17 +248,6 @@ void MindMapNode::paint(QPainter* painter, const QStyleOptionGraphicsItem* optio
                              buttonRect.center().x(), buttonRect.bottom() - 5);
         }
     }
-
-    if (option->state & QStyle::State_MouseOver) {
-        painter->setBrush(QColor(255, 255, 255, 100));
-        painter->drawRoundedRect(rect, 10, 10);
-    }
-}
-
-QRectF MindMapNode::expandButtonRect() const
-{
-    QRectF rect = boundingRect();
-    return QRectF(rect.right() - 25, rect.center().y() - 8, 16, 16);
 }
 
 void MindMapNode::setExpanded(bool expanded)
@@ -109,14 +256,12 @@ void MindMapNode::setExpanded(bool expanded)
 
     m_expanded = expanded;
 
-    // 设置子节点可见性
-    for (MindMapNode* child : m_children) {
-        child->setExpanded(expanded);
-        // 递归设置子节点的连接线可见性
-        for (Connection* conn : child->connections()) {
-            conn->setVisible(expanded);
-        }
-         delete child;
+    // 展开时按需创建子节点；虚拟化时子节点由模型和视口决定
+    if (expanded && m_hasUnloadedChildren && m_modelIndex < 0) loadAllChild();
+
+    // 设置子节点可见性，隐藏父项会一并隐藏整棵子树
+    for (MindMapNode* child : std::as_const(m_children)) {
+        child->setVisible(expanded);
     }
 
     // 设置直接连接线的可见性
@@ -127,11 +272,21 @@ void MindMapNode::setExpanded(bool expanded)
     }
 
     // 保存状态
-    //if (!m_loading) saveToJson();
+    markDirty();
+
+    // 由场景记录折叠时间，超出图形项预算时释放
+    if (MindMapScene* owner = mindMapScene()) owner->nodeExpandedChanged(this);
 
     update();
 }
 
+void MindMapNode::setDimmed(bool dimmed)
+{
+    if (m_dimmed == dimmed) return;
+    m_dimmed = dimmed;
+    update();
+}
+
 void MindMapNode::toggleExpanded()
 {
     setExpanded(!m_expanded);
@@ -140,11 +295,13 @@ void MindMapNode::toggleExpanded()
 void MindMapNode::setText(const QString& text)
 {
     m_text = text;
-    update();
+    updateGeometry();
 
     // 保存状态
     if (!m_loading) {
+        recordEdit("text", text);
         changeJson("text",text,"change");
+        if (MindMapScene* owner = mindMapScene()) owner->nodeTextChanged(this);
     }
     //if (!m_loading) saveToJson();
 }
@@ -156,97 +313,183 @@ QString MindMapNode::text() const
 
 void MindMapNode::setColor(const QColor& color)
 {
-    m_color = color;
+    m_colorIndex = ColorPalette::index(color);
     update();
 
     // 保存状态
-    if (!m_loading) changeJson("color",color.name(),"change");
+    if (!m_loading) {
+        recordEdit("color", color.name());
+        changeJson("color",color.name(),"change");
+    }
 }
 
 QColor MindMapNode::color() const
 {
-    return m_color;
+    return ColorPalette::color(m_colorIndex);
 }
 
 void MindMapNode::addTag(const QString &tag) {
-    m_tags.append(tag);
-    if (m_loading) changeJson("tag",tag,"change");
+    const quint32 id = SymbolTable::tags().id(tag);
+    if (hasTag(id)) return;
+    insertTag(id);
+    if (!m_loading) {
+        recordEdit("tag", tag);
+        changeJson("tags",tag,"append");
+        if (MindMapScene* owner = mindMapScene()) owner->nodeTagChanged(this, tag, true);
+    }
+}
+
+void MindMapNode::removeTag(const QString& tag)
+{
+    const int id = SymbolTable::tags().find(tag);
+    if (id < 0 || !hasTag(quint32(id))) return;
+    m_tags.removeOne(quint32(id));
+    if (!m_loading) {
+        recordEdit("untag", tag);
+        changeJson("tags",tag,"remove");
+        if (MindMapScene* owner = mindMapScene()) owner->nodeTagChanged(this, tag, false);
+    }
+}
+
+
+void MindMapNode::insertTag(quint32 id)
+{
+    // 标签编号有序且不重复，查找时可二分
+    auto it = std::lower_bound(m_tags.begin(), m_tags.end(), id);
+    if (it == m_tags.end() || *it != id) m_tags.insert(it, id);
 }
 
+bool MindMapNode::hasTag(quint32 id) const
+{
+    return std::binary_search(m_tags.cbegin(), m_tags.cend(), id);
+}
+
+QStringList MindMapNode::tags() const
+{
+    QStringList names;
+    names.reserve(m_tags.size());
+    for (quint32 id : m_tags) names.append(SymbolTable::tags().name(int(id)));
+    return names;
+}
 
 void MindMapNode::setFolderPath(const QString& path)
 {
-    m_folderPath = path;
+    const QString oldName = folderName();
+    assignPath(path);
+    pathChanged(oldName);
 
     // 保存状态
     if (!m_loading) changeJson("path",path,"change");
 }
 
+void MindMapNode::assignPath(const QString& path)
+{
+    // 位于父节点文件夹下一层时只保存文件夹名，共享驻留表中的字符串
+    if (MindMapNode* parent = parentNode()) {
+        const QString base = parent->folderPath();
+        if (!base.isEmpty() && path.size() > base.size() + 1 && path.startsWith(base)
+            && path.at(base.size()) == '/' && path.indexOf('/', base.size() + 1) < 0) {
+            m_segment = SymbolTable::segments().intern(path.mid(base.size() + 1));
+            m_relativePath = true;
+            return;
+        }
+    }
+    m_segment = path;
+    m_relativePath = false;
+}
+
+void MindMapNode::pathChanged(const QString& oldName)
+{
+    MindMapNode* parent = parentNode();
+    const QString name = folderName();
+    if (parent && name != oldName && parent->m_childIndex.value(oldName) == this) {
+        parent->m_childIndex.remove(oldName);
+        parent->m_childIndex.insert(name, this);
+    }
+    if (MindMapScene* owner = mindMapScene()) owner->nodePathChanged(this);
+}
+
 QString MindMapNode::folderPath() const
 {
-    return m_folderPath;
+    // 完整路径按需由祖先的路径段拼出
+    if (m_relativePath) {
+        if (MindMapNode* parent = parentNode()) return parent->folderPath() + '/' + m_segment;
+    }
+    return m_segment;
 }
 
 QDir MindMapNode::directory() const
 {
-    return QDir(m_folderPath);
+    return QDir(folderPath());
 }
 
 // JSON存储功能实现
 QJsonObject MindMapNode::getJson() const{
-    if (m_folderPath.isEmpty()) return QJsonObject();
+    // 内存文档即权威版本，不再读盘
+    return toJson();
+}
 
-    QFile file(QDir(m_folderPath).filePath("node.json"));
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "无法打开文件读取:" << file.fileName();
-        return QJsonObject();
-    }
+void MindMapNode::applyJson(const QJsonObject& json) {
+    // 整体替换内存文档，成员状态随之更新，落盘交给延迟写入队列
+    const QString oldPath = folderPath();
+    const QString oldName = folderName();
+    m_loading = true;
+    fromJson(json);
+    m_loading = false;
+    if (folderPath() != oldPath) pathChanged(oldName);
+    markDirty();
+}
 
-    QByteArray data = file.readAll();
-    file.close();
 
-    QJsonDocument doc = QJsonDocument::fromJson(data);
-    if (doc.isNull() || !doc.isObject()) {
-        qWarning() << "无效的JSON文件:" << file.fileName();
-        return QJsonObject();
-    }
-    return doc.object();
+void MindMapNode::saveToJson()
+{
+    if (m_segment.isEmpty()) return;
+
+    // 不在场景中时没有延迟写入队列，单独原子写入
+    FolderStorage::writeFile(folderPath(), toJson());
 }
-//Json 析构？
-void MindMapNode::applyJson(const QJsonObject& json) {
-    if (m_folderPath.isEmpty()) return;
 
-    QFile file(QDir(m_folderPath).filePath("node.json"));
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "无法打开文件写入:" << file.fileName();
-        return;
-    }
+MindMapScene* MindMapNode::mindMapScene() const
+{
+    return qobject_cast<MindMapScene*>(scene());
+}
 
-    file.write(QJsonDocument(json).toJson());
-    file.close();
+SaveQueue* MindMapNode::saveQueue() const
+{
+    MindMapScene* owner = mindMapScene();
+    return owner ? owner->saveQueue() : nullptr;
 }
 
+QSharedPointer<MapStorage> MindMapNode::storage() const
+{
+    SaveQueue* queue = saveQueue();
+    if (queue && queue->storage()) return queue->storage();
+    return MapStorage::create(MapStorage::FolderFormat, folderPath());
+}
 
-void MindMapNode::saveToJson()
+void MindMapNode::markDirty()
 {
-    if (m_folderPath.isEmpty()) return;
+    if (m_loading) return;
 
-    QFile file(QDir(m_folderPath).filePath("node.json"));
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "无法打开文件写入:" << file.fileName();
-        return;
+    // 在场景中时交给延迟写入队列合并，否则直接写入
+    if (SaveQueue* queue = saveQueue()) {
+        queue->markDirty(this);
+    } else {
+        saveToJson();
     }
+}
 
-    QJsonObject json = toJson();
-    file.write(QJsonDocument(json).toJson());
-    file.close();
+void MindMapNode::recordEdit(const QString& op, const QJsonValue& value)
+{
+    if (m_loading || m_segment.isEmpty()) return;
+    if (MindMapScene* owner = mindMapScene()) owner->recordEdit(op, folderPath(), value);
 }
 
 void MindMapNode::loadFromJson()
 {
-    if (m_folderPath.isEmpty()) return;
+    if (m_segment.isEmpty()) return;
 
-    QFile file(QDir(m_folderPath).filePath("node.json"));
+    QFile file(QDir(folderPath()).filePath("node.json"));
     if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "无法打开文件读取:" << file.fileName();
         return;
@@ -266,56 +509,54 @@ void MindMapNode::loadFromJson()
 
 QJsonObject MindMapNode::toJson() const
 {
-    QJsonObject json;
+    // 以内存文档为底（children 等由补丁维护的字段），补上由成员状态生成的字段
+    QJsonObject json = m_document;
     json["text"] = m_text;
-    json["color"] = m_color.name();
+    json["color"] = color().name();
     json["expanded"] = m_expanded;
     json["position_x"] = pos().x();
     json["position_y"] = pos().y();
-    json["path"] = m_folderPath;
+    json["path"] = folderPath();
 
     //存储标签
     QJsonArray tagArray;
-    for (QString tag : m_tags) {
-        tagArray.append(tag);
+    for (quint32 id : m_tags) {
+        tagArray.append(SymbolTable::tags().name(int(id)));
     }
     json["tags"] = tagArray;
 
-    // 存储子节点路径（相对路径）
-    // QJsonArray childrenArray;
-    // for (MindMapNode* child : m_children) {
-    //     QDir rootDir(m_folderPath);
-    //     childrenArray.append(rootDir.relativeFilePath(child->folderPath()));
-    // }
-    // json["children"] = childrenArray;
-
     //设置存储子节点
-    QJsonArray childArray;
-    json["children"] = childArray;
+    if (!json.contains("children")) json["children"] = QJsonArray();
 
     //设置存储未显示的子节点
-    QJsonArray hiddenChildArray;
-    json["hiddenChildren"] = hiddenChildArray;
-
-    // 存储连接信息
-    QJsonArray connectionsArray;
-    for (Connection* conn : m_connections) {
-        if (conn->destinationNode() && conn->destinationNode() != this) {
-            QDir rootDir(m_folderPath);
-            connectionsArray.append(rootDir.relativeFilePath(conn->destinationNode()->folderPath()));
-        }
-    }
-    json["connections"] = connectionsArray;
+    if (!json.contains("hiddenChildren")) json["hiddenChildren"] = QJsonArray();
 
     return json;
 }
 
+void MindMapNode::keepDocument(const QJsonObject& json)
+{
+    // 只留下成员中没有的字段；跨节点连线统一保存在场景的连线表中，旧版本的字段打开时已导入
+    m_document = json;
+    for (const char* field : kDerivedFields) m_document.remove(QLatin1String(field));
+    // 空的子节点列表由 toJson 补齐，不必每个叶子节点都存一份
+    for (const char* field : { "children", "hiddenChildren" }) {
+        const QJsonValue value = m_document.value(QLatin1String(field));
+        if (value.isArray() && value.toArray().isEmpty()) m_document.remove(QLatin1String(field));
+    }
+}
+
 void MindMapNode::fromJson(const QJsonObject& json)
 {
-    if (json.contains("text")) m_text = json["text"].toString();
-    if (json.contains("color")) m_color = QColor(json["color"].toString());
+    keepDocument(json);
+
+    if (json.contains("text") && json["text"].toString() != m_text) {
+        m_text = json["text"].toString();
+        updateGeometry();
+    }
+    if (json.contains("color")) m_colorIndex = ColorPalette::index(QColor(json["color"].toString()));
     if (json.contains("expanded")) m_expanded = json["expanded"].toBool();
-    if (json.contains("path")) m_folderPath = json["path"].toString();
+    if (json.contains("path")) assignPath(json["path"].toString());
 
     if (json.contains("position_x") && json.contains("position_y")) {
         qreal x = json["position_x"].toDouble();
@@ -324,8 +565,9 @@ void MindMapNode::fromJson(const QJsonObject& json)
     }
 
     if (json.contains("tags") && json["tags"].isArray()) {
+        m_tags.clear();
         for (QJsonValueRef tag : json["tags"].toArray()) {
-            m_tags.append(tag.toString());
+            insertTag(SymbolTable::tags().id(tag.toString()));
         }
     }
     // 注意：子节点和连接将在场景加载时处理
@@ -333,9 +575,16 @@ void MindMapNode::fromJson(const QJsonObject& json)
 
 void MindMapNode::changeJson(const QString &header, const QString &info, const QString &action) {
 
-    QJsonObject json = getJson();
-    if (!json.contains(header) && info !="create") {
-        qDebug()<< "对应json类型<UNK>:" ;
+    // 由成员状态生成的字段已随成员更新，只需标记待写
+    if (isDerivedField(header)) {
+        markDirty();
+        return;
+    }
+
+    // 直接修改内存文档，落盘交给延迟写入队列合并
+    QJsonObject& json = m_document;
+    if (!json.contains(header) && info !="create" && action != "append") {
+        qDebug()<< "对应json类型<UNK>:" << header;
         return;
     }
 
@@ -348,82 +597,78 @@ void MindMapNode::changeJson(const QString &header, const QString &info, const Q
     }
 
     if (action == "append") {
-        QJsonArray temp;
-        temp = json[header].toArray();
+        QJsonArray temp = json[header].toArray();
         temp.append(info);
         json[header] = temp;
     }
 
     if (action == "remove") {
-        QJsonArray tempA;
-        tempA = json[header].toArray();//转出
-        QList<QString> tempL;//换成列表来删
-        for (QJsonValue value : tempA) {
-            if (value.isString()) {
-                tempL.append(value.toString());
-            }
-        }
-        for (auto ilt=tempL.begin(); ilt != tempL.end(); ilt++) {
-            if (*ilt == info) {
-                tempL.erase(ilt);
-            }
-        }
-
-        QJsonArray tempB;//还回去
-        for (QString str : tempL) {
-            tempB.append(str);
+        QJsonArray temp = json[header].toArray();
+        for (qsizetype i = temp.size() - 1; i >= 0; --i) {
+            if (temp.at(i).toString() == info) temp.removeAt(i);
         }
-
-        json[header] = tempB;
+        json[header] = temp;
     }
 
-    applyJson(json);
+    markDirty();
 }
 
 
 void MindMapNode::addChild(MindMapNode* child)
 {
-    if (!m_children.contains(child)) {
+    if (m_childIndex.value(child->folderName()) != child) {
         m_children.append(child);
 
         // 设置子节点的文件夹路径
-        if (!m_folderPath.isEmpty()) {
-            QDir dir(m_folderPath);
+        if (!m_segment.isEmpty()) {
+            QDir dir(folderPath());
             dir.mkpath(child->text());
             child->setFolderPath(dir.filePath(child->text()));
         }
+        m_childIndex.insert(child->folderName(), child);
     }
 
-    QDir rootDir(m_folderPath);
+    QDir rootDir(folderPath());
          //childrenArray.append(rootDir.relativeFilePath(child->folderPath()));
-    if (!m_loading) changeJson("children",rootDir.relativeFilePath(child->folderPath()),"append");
+    if (!m_loading) {
+        recordEdit("addChild", child->folderName());
+        changeJson("children",rootDir.relativeFilePath(child->folderPath()),"append");
+    }
     // 保存状态
     //if (!m_loading) saveToJson();
 }
 
+void MindMapNode::attachChild(MindMapNode* child)
+{
+    // 加载时挂接已存在的子节点，文件夹和文档都已就绪，无需写盘
+    const QString name = child->folderName();
+    if (m_childIndex.value(name) == child) return;
+    m_children.append(child);
+    m_childIndex.insert(name, child);
+}
+
+void MindMapNode::sortChildren()
+{
+    std::sort(m_children.begin(), m_children.end(), [](MindMapNode* a, MindMapNode* b) {
+        return QString::compare(a->folderName(), b->folderName(), Qt::CaseInsensitive) < 0;
+    });
+}
+
 void MindMapNode::removeChild(const QString& name) {
 
-    //检测是否正在显示
-    foreach(MindMapNode* child, m_children) {
-        if (name==child->text()) {
-            child->removeAllChild();
-
-            QDir rootDir(m_folderPath);
-            changeJson("children",rootDir.filePath(name),"remove");
-            QDir childDir(rootDir.filePath(name));
-            childDir.removeRecursively();
-            //删除正在显示的节点
-            delete child;
-            child = nullptr;
-            return;
-        }
-    }
-    //在JSON和文件夹中删除
+    recordEdit("removeChild", name);
+
+    QDir rootDir(folderPath());
+    const QString childPath = rootDir.filePath(name);
     changeJson("children",name,"remove");
-    QDir rootDir(m_folderPath);
-    QDir childDir(rootDir.filePath(name));
-    childDir.removeRecursively();
+    if (SaveQueue* queue = saveQueue()) queue->removeTree(childPath);
+
+    //删除正在显示的节点（连同其子树和连接线）
+    if (MindMapNode* child = m_childIndex.value(name)) destroyChild(child);
 
+    //在文件夹中删除
+    QDir childDir(childPath);
+    childDir.removeRecursively();
 }
 
 void MindMapNode::removeAllChild()
@@ -438,71 +683,115 @@ void MindMapNode::removeAllChild()
 }
 
 void MindMapNode::loadChild(const QString &name) {
+    if (m_segment.isEmpty()) return;
+
     //检测是否已经显示
-    foreach(MindMapNode* child, m_children) {
-        if (name==child->text()) {
-            return;
-        }
-    }
+    if (m_childIndex.contains(name)) return;
 
-    MindMapNode* child = new MindMapNode(name, "");
-    //ADD CHILD INFO
-    m_children.append(child);
-    child->loadAllChild();
+    // 只创建这一层，孙节点保持为磁盘上的记录；还在写入队列中的文档比存储中的新
+    NodeRecord record = storage()->loadNode(QDir(folderPath()).filePath(name));
+    if (SaveQueue* queue = saveQueue()) queue->overlay(record);
+    MindMapNode* child = createChild(record);
+    attachChild(child);
+    child->setVisible(m_expanded);
+    sortChildren();
 }
 
 
 void MindMapNode::loadAllChild() {
-    QJsonObject json = getJson();
-    QJsonArray unloadedchild = json["children"].toArray();
-    for (QJsonValueRef qchild : unloadedchild) {
-        bool flag=false;
-
-        foreach(MindMapNode* child, m_children) {
-            if (qchild.toString()==child->text()) {
-                flag=true;
-            }
-        }
+    if (m_segment.isEmpty()) return;
 
-        if (!flag) {
-            loadChild(qchild.toString());
-        }
+    QList<NodeRecord> records = storage()->loadChildren(folderPath());
+    if (SaveQueue* queue = saveQueue()) queue->overlayChildren(folderPath(), records);
+    for (const NodeRecord& record : std::as_const(records)) {
+        if (m_childIndex.contains(record.name)) continue;
 
+        MindMapNode* child = createChild(record);
+        attachChild(child);
+        child->setVisible(m_expanded);
     }
+    m_hasUnloadedChildren = false;
+    sortChildren();
 
+    // 保存为展开状态的子节点，其子树也需要显示
+    for (MindMapNode* child : std::as_const(m_children)) {
+        if (child->m_expanded && child->m_hasUnloadedChildren) child->loadAllChild();
+    }
 }
 
 
 void MindMapNode::hideChild(MindMapNode *child) {
     if (child == nullptr) {
-        qDebug() << "MindMapNode::saveChild: null child";
+        qDebug() << "MindMapNode::hideChild: null child";
         return;
     }
+
+    // 待写的文档由 dispose 留在写入队列中，再次加载时从队列取回
+    destroyChild(child);
+    m_hasUnloadedChildren = true;
+}
+
+void MindMapNode::destroyChild(MindMapNode* child)
+{
     //从正在显示的列表中剔除
-    for (auto ilt = m_children.begin(); ilt != m_children.end(); ilt++) {
-        if (*ilt == child) {
-            m_children.erase(ilt);
-            break;
-        }
-    }
-    child->hideAllChild();
-    //删除操作
-    delete child;
-    child = nullptr;
+    m_children.removeOne(child);
+    if (m_childIndex.value(child->folderName()) == child) m_childIndex.remove(child->folderName());
+    dispose(child);
+}
 
+void MindMapNode::destroyChildren()
+{
+    // 整批摘下，不逐个在列表中查找删除
+    const QList<MindMapNode*> children = std::exchange(m_children, {});
+    m_childIndex.clear();
+    for (MindMapNode* child : children) dispose(child);
 }
 
-void MindMapNode::hideAllChild() {
-    for (MindMapNode* child : m_children) {
-        hideChild(child);
+void MindMapNode::dispose(MindMapNode* child)
+{
+    child->destroyChildren();
+
+    // 连接线随节点一起释放，回收或析构时会从两端的列表中移除
+    ItemPool* pool = mindMapScene() ? mindMapScene()->itemPool() : nullptr;
+    const QList<Connection*> connections = child->connections();
+    for (Connection* conn : connections) {
+        if (conn->sourceNode() && conn->sourceNode() != child) conn->sourceNode()->removeConnection(conn);
+        if (conn->destinationNode() && conn->destinationNode() != child) conn->destinationNode()->removeConnection(conn);
+        if (pool) pool->recycle(conn);
+        else delete conn;
     }
+
+    // 还没写出的修改留在写入队列中随下一批写出，不在这里等待落盘
+    SaveQueue* queue = saveQueue();
+    if (queue && queue->isPending(child)) queue->detach(child, child->toJson());
+
+    // 放回回收池，下次展开或加载时复用
+    if (pool) pool->recycle(child);
+    else delete child;
 }
 
+MindMapNode* MindMapNode::createChild(const NodeRecord& record)
+{
+    if (MindMapScene* owner = mindMapScene()) return owner->itemPool()->takeNode(record, this);
+    return new MindMapNode(record, this);
+}
 
+void MindMapNode::hideAllChild() {
+    if (m_children.isEmpty()) return;
 
-QList<MindMapNode*> MindMapNode::children() const
+    // 待写的文档由 dispose 逐个留在写入队列中，释放不等待写入
+    destroyChildren();
+    m_hasUnloadedChildren = true;
+}
+
+bool MindMapNode::hasChildren() const
 {
-    return m_children;
+    return !m_children.isEmpty() || m_hasUnloadedChildren;
+}
+
+QString MindMapNode::folderName() const
+{
+    return m_relativePath ? m_segment : m_segment.section('/', -1);
 }
 
 MindMapNode* MindMapNode::parentNode() const
@@ -521,36 +810,18 @@ bool MindMapNode::isRoot() const
 
 void MindMapNode::addConnection(Connection* connection)
 {
-    if (!m_connections.contains(connection)) {
-        m_connections.append(connection);
-        if (!m_folderPath.isEmpty()) {
-            QDir dir(m_folderPath);
-            if (this->text()==connection->destinationNode()->text()) {
-                dir.mkpath(connection->sourceNode()->text());
-                child->setFolderPath(dir.filePath(child->text()));
-            }
-
-        }
-    }
-
-
-
-
-        // 设置子节点的文件夹路径
-
-
-
-
-    // 保存状态
-    if (!m_loading) saveToJson();
+    // 连线关系由父子结构和场景的连线表保存，不写入节点文档
+    if (!m_connections.contains(connection)) m_connections.append(connection);
 }
 
 void MindMapNode::removeConnection(Connection* connection)
 {
     m_connections.removeAll(connection);
+}
 
-    // 保存状态
-    if (!m_loading) saveToJson();
+void MindMapNode::releaseConnection(Connection* connection)
+{
+    m_connections.removeAll(connection);
 }
 
 QList<Connection*> MindMapNode::connections() const
@@ -561,17 +832,36 @@ QList<Connection*> MindMapNode::connections() const
 QVariant MindMapNode::itemChange(GraphicsItemChange change, const QVariant& value)
 {
     if (change == ItemPositionHasChanged) {
-        // 更新所有连接线
+        // 批量更新期间位置由布局统一给出，不逐个保存，连线在结束时统一更新
+        MindMapScene* owner = mindMapScene();
+        if (owner && owner->isBulkUpdating()) return QGraphicsItem::itemChange(change, value);
+        // 鼠标拖动中按帧更新连线，松开时才保存
+        if (owner && owner->dragSession()->nodeMoved(this)) return QGraphicsItem::itemChange(change, value);
+
+        // 更新所有连接线；子节点是子图形项，随本节点一起移动和重绘
         for (Connection* connection : m_connections) {
             connection->updatePath();
         }
-        // 更新子节点位置
-        for (MindMapNode* child : m_children) {
-            child->update();
+        if (owner) owner->nodeMoved(this);
+        commitPosition();
+    }
+    else if (change == ItemParentChange) {
+        // 换父项前先转成绝对路径，挂到新父项后再拆成相对的一段
+        if (m_relativePath) {
+            m_segment = folderPath();
+            m_relativePath = false;
         }
-
-        // 保存位置信息
-        if (!m_loading) saveToJson();
+    }
+    else if (change == ItemParentHasChanged) {
+        if (!m_segment.isEmpty()) assignPath(m_segment);
+    }
+    else if (change == ItemSceneChange) {
+        // 离开旧场景前通知其清理对本节点的引用
+        if (MindMapScene* owner = mindMapScene()) owner->nodeRemoved(this);
+    }
+    else if (change == ItemSceneHasChanged) {
+        if (MindMapScene* owner = mindMapScene()) owner->nodeAdded(this);
+        updateGeometry(); // 场景字体可能不同
     }
     return QGraphicsItem::itemChange(change, value);
 }
@@ -579,7 +869,7 @@ QVariant MindMapNode::itemChange(GraphicsItemChange change, const QVariant& valu
 void MindMapNode::mousePressEvent(QGraphicsSceneMouseEvent* event)
 {
     // 检查是否点击了展开/折叠按钮
-    if (event->button() == Qt::LeftButton && !m_children.isEmpty()) {
+    if (event->button() == Qt::LeftButton && hasChildren()) {
         QRectF buttonRect = expandButtonRect();
         if (buttonRect.contains(event->pos())) {
             toggleExpanded();
@@ -589,11 +879,29 @@ void MindMapNode::mousePressEvent(QGraphicsSceneMouseEvent* event)
     }
 
     QGraphicsItem::mousePressEvent(event);
+    if (event->button() == Qt::LeftButton && (flags() & ItemIsMovable)) {
+        if (MindMapScene* owner = mindMapScene()) owner->dragSession()->press(this);
+    }
+}
+
+void MindMapNode::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
+{
+    QGraphicsItem::mouseReleaseEvent(event);
+    if (event->button() == Qt::LeftButton) {
+        if (MindMapScene* owner = mindMapScene()) owner->dragSession()->release();
+    }
 }
 
 void MindMapNode::setPosition(const QPointF& pos)
 {
     setPos(pos);
-    saveToJson(); // 确保位置变化时保存
+    markDirty(); // 位置变化交给延迟写入队列
+}
+
+void MindMapNode::commitPosition()
+{
+    // 保存位置信息（记入编辑日志，合并到延迟写入队列）
+    recordEdit("pos", QJsonArray{ pos().x(), pos().y() });
+    markDirty();
 }
 
@@ -1,5 +1,13 @@
 #include "MindMapScene.h"
 #include "Connection.h"
+#include "SaveQueue.h"
+#include "PackedStorage.h"
+#include "MapLoader.h"
+#include "LayoutWorker.h"
+#include "ViewportVirtualizer.h"
+#include "DragSession.h"
+#include "SymbolTable.h"
+#include "ColorPalette.h"
 #include <QGraphicsSceneMouseEvent>
 #include <QMenu>
 #include <QAction>
@@ -12,21 +20,84 @@
 #include <QDesktopServices>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QSet>
 #include <QJsonDocument>
 #include <QFile>
 #include <QByteArray>
 #include <QGraphicsView>
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <utility>
+
+namespace {
+const int kDefaultItemBudget = 20000;
+const qint64 kMinCollapsedAge = 10000; // 折叠超过10秒的子树才允许释放
+const int kAsyncLayoutThreshold = 2000;  // 节点数超过此值时在后台计算全量布局
+}
 
 MindMapScene::MindMapScene(QObject* parent)
-    : QGraphicsScene(parent), m_rootNode(nullptr)
+    : QGraphicsScene(parent), m_rootNode(nullptr), m_saveQueue(new SaveQueue(this)),
+      m_format(MapStorage::FolderFormat), m_loader(new MapLoader(this)),
+      m_lazyLoading(true), m_itemBudget(kDefaultItemBudget), m_nodeCount(0),
+      m_budgetTimer(new QTimer(this)), m_linkTimer(new QTimer(this)), m_layoutTimer(new QTimer(this)),
+      m_layoutWorker(new LayoutWorker(this)), m_structureVersion(0), m_centerAfterLayout(false),
+      m_edgeLayerEnabled(true), m_bulkDepth(0), m_indexMethod(BspTreeIndex), m_openBulk(false),
+      m_clearing(false), m_virtualized(false), m_modelActive(false), m_indexFromLoad(false), m_searchFromLoad(false), m_linksFromLoad(false), m_indexing(false),
+      m_highlightMatch(TagIndex::MatchAll), m_highlightFilter(false)
+{
+    m_virtualizer = new ViewportVirtualizer(this, &m_model, this);
+    m_dragSession = new DragSession(this);
+    m_clock.start();
+    m_budgetTimer->setSingleShot(true);
+    connect(m_budgetTimer, &QTimer::timeout, this, &MindMapScene::enforceItemBudget);
+    m_linkTimer->setSingleShot(true);
+    connect(m_linkTimer, &QTimer::timeout, this, &MindMapScene::restorePendingLinks);
+    m_layoutTimer->setSingleShot(true);
+    connect(m_layoutTimer, &QTimer::timeout, this, &MindMapScene::applyLayout);
+    connect(m_layoutWorker, &LayoutWorker::finished, this, &MindMapScene::finishFullLayout);
+
+    connect(m_loader, &MapLoader::recordsReady, this, &MindMapScene::appendRecords);
+    connect(m_loader, &MapLoader::progress, this, &MindMapScene::openProgress);
+    connect(m_loader, &MapLoader::finished, this, &MindMapScene::finishOpen);
+    connect(m_loader, &MapLoader::indexesReady, this, &MindMapScene::installIndexes);
+}
+
+MindMapScene::~MindMapScene()
+{
+    // 节点析构前写出待保存的修改
+    m_loader->abort();
+    m_layoutWorker->abort();
+    endOpenBulkUpdate();
+    flushPending();
+    clearMap();
+}
+
+void MindMapScene::flushPending()
+{
+    m_saveQueue->flush();
+}
+
+void MindMapScene::setDurability(DurableWriter::Durability durability)
+{
+    m_saveQueue->setDurability(durability);
+}
+
+DurableWriter::Durability MindMapScene::durability() const
 {
+    return m_saveQueue->durability();
 }
 
 bool MindMapScene::createNewMap(const QString& path)
 {
-    // 清除现有场景
-    clear();
-    m_rootNode = nullptr;
+    // 清除现有场景前写出上一张图的修改
+    m_loader->abort();
+    endOpenBulkUpdate();
+    flushPending();
+    clearMap();
+    m_layoutWorker->abort();
+    m_layout.clear();
+    m_modelActive = false;
 
     // 创建根目录
     QDir dir(path);
@@ -35,21 +106,46 @@ bool MindMapScene::createNewMap(const QString& path)
         return false;
     }
 
+    // 先回放日志再交给写入队列，队列清理临时文件时回放已经结束
+    QSharedPointer<MapStorage> storage = MapStorage::create(m_format, path);
+    openJournal(path, *storage);
+    m_saveQueue->setStorage(storage);
+    m_tagIndex.reset(path);
+    m_tagIndex.setComplete(true); // 新图没有标签
+    m_searchIndex.reset(path);
+    m_searchIndex.setComplete(true);
+    m_links.reset(path);
+    m_links.setComplete(true);
+
     // 创建根节点
-    m_rootNode = new MindMapNode(dir.dirName(), path);
+    NodeRecord record;
+    record.id = 0;
+    record.name = dir.dirName();
+    record.path = path;
+    record.json = m_saveQueue->storage()->readNode(path);
+    m_rootNode = new MindMapNode(record);
     addItem(m_rootNode);
     m_rootNode->setPos(0, 0);
 
     m_mapPath = path;
     updateLayout();
+
+    // 立即写出根节点文档
+    m_rootNode->markDirty();
+    flushPending();
     return true;
 }
 
 bool MindMapScene::openMap(const QString& path)
 {
-    // 清除现有场景
-    clear();
-    m_rootNode = nullptr;
+    // 清除现有场景前写出上一张图的修改
+    m_loader->abort();
+    endOpenBulkUpdate();
+    flushPending();
+    clearMap();
+    m_loadingNodes.clear();
+    m_layoutWorker->abort();
+    m_layout.clear();
 
     // 检查目录是否存在
     QDir dir(path);
@@ -58,111 +154,748 @@ bool MindMapScene::openMap(const QString& path)
         return false;
     }
 
-    // 创建根节点
-    m_rootNode = new MindMapNode(dir.dirName(), path);
-    addItem(m_rootNode);
-    m_rootNode->setPos(0, 0);
+    // 按目录内容选择存储后端，在后台并行读出节点记录
+    QSharedPointer<MapStorage> storage = MapStorage::create(MapStorage::detect(path), path);
+    // 回放过日志说明上次没有正常关闭，保存的标签和搜索索引可能过期
+    m_tagIndex.reset(path);
+    m_searchIndex.reset(path);
+    if (openJournal(path, *storage)) {
+        m_tagIndex.discard();
+        m_searchIndex.discard();
+    } else {
+        m_tagIndex.load();
+        m_searchIndex.load();
+    }
+    // 回放之后再交给写入队列，队列会在后台清理上次中断留下的临时文件
+    m_saveQueue->setStorage(storage);
+    m_links.reset(path);
+    m_links.load();
+    m_format = storage->format();
+    m_mapPath = path;
 
-    // 递归加载子节点
-    recursiveLoadChildren(m_rootNode);
+    // 整个加载过程不维护索引，完成后一次性重建
+    beginBulkUpdate();
+    m_openBulk = true;
 
-    // 恢复连接
-    restoreConnections(m_rootNode);
+    // 虚拟化时整棵树都进入模型，不做按需加载
+    m_modelActive = m_virtualized;
+    const bool lazy = m_lazyLoading && !m_modelActive;
+    // 没有可用的索引且会读入全部节点时，顺带建立索引
+    m_indexFromLoad = !m_tagIndex.isComplete() && !lazy;
+    m_searchFromLoad = !m_searchIndex.isComplete() && !lazy;
+    m_linksFromLoad = !m_links.isComplete() && !lazy;
+    m_loader->start(storage, lazy);
+    emit openStarted(path);
+    return true;
+}
 
-    m_mapPath = path;
+bool MindMapScene::openJournal(const QString& path, MapStorage& storage)
+{
+    // 日志非空说明上次没有正常关闭，先把记录回放到存储再加载
+    QSharedPointer<MapJournal> journal(new MapJournal(path));
+    const bool recovered = journal->needsRecovery();
+    if (recovered) {
+        const int replayed = journal->replay(storage);
+        if (replayed < 0) {
+            // 回放结果没有写入存储：不接管这份日志，本次会话的写入也不会截断它，
+            // 留待下次打开再回放
+            QMessageBox::warning(nullptr, "警告", "编辑日志中的修改无法写回，已保留日志: " + journal->filePath());
+            m_journal.reset();
+            m_saveQueue->setJournal(QSharedPointer<MapJournal>());
+            return true;
+        }
+        qWarning() << "从编辑日志恢复了" << replayed << "条修改:" << journal->filePath();
+    }
+    journal->open();
+
+    m_journal = journal;
+    m_saveQueue->setJournal(journal);
+    return recovered;
+}
+
+void MindMapScene::recordEdit(const QString& op, const QString& folderPath, const QJsonValue& value)
+{
+    if (m_journal) m_journal->append(op, folderPath, value);
+}
+
+void MindMapScene::cancelOpen()
+{
+    m_loader->cancel();
+}
+
+bool MindMapScene::isOpening() const
+{
+    return m_loader->isRunning();
+}
+
+void MindMapScene::appendRecords(const QList<NodeRecord>& records)
+{
+    if (m_searchFromLoad) {
+        for (const NodeRecord& record : records) m_searchIndex.addRecord(record);
+    }
+    if (m_linksFromLoad) {
+        for (const NodeRecord& record : records) m_links.addRecord(record);
+    }
+    if (m_indexFromLoad) {
+        for (const NodeRecord& record : records) {
+            const QJsonArray tags = record.json["tags"].toArray();
+            if (tags.isEmpty()) continue;
+            QStringList names;
+            for (const QJsonValue& tag : tags) names.append(tag.toString());
+            m_tagIndex.addNode(record.path, names);
+        }
+    }
+
+    // 虚拟化时只进入模型，图形项由视口决定
+    if (m_modelActive) {
+        for (const NodeRecord& record : records) m_model.append(record);
+        return;
+    }
+
+    // 父记录总在子记录之前送达，逐批创建图形项
+    for (const NodeRecord& record : records) {
+        MindMapNode* parent = record.parent >= 0 ? m_loadingNodes.value(record.parent) : nullptr;
+        if (record.parent >= 0 && !parent) continue;
+
+        MindMapNode* node = m_itemPool.takeNode(record, parent);
+        if (parent) {
+            parent->attachChild(node);
+            node->setVisible(parent->isExpanded());
+        } else {
+            addItem(node);
+            node->setPos(0, 0);
+            m_rootNode = node;
+        }
+        m_loadingNodes.insert(record.id, node);
+
+        // 补写缺失的节点文档
+        if (record.json.isEmpty()) node->markDirty();
+    }
+}
+
+void MindMapScene::finishOpen(bool ok)
+{
+    m_loadingNodes.clear();
+    if (ok && m_indexFromLoad) m_tagIndex.setComplete(true);
+    if (ok && m_searchFromLoad) m_searchIndex.setComplete(true);
+    if (ok && m_linksFromLoad) {
+        m_links.setComplete(true);
+        m_links.save();   // 以后直接读入连线表
+    }
+    m_indexFromLoad = false;
+    m_searchFromLoad = false;
+    m_linksFromLoad = false;
+
+    if (!ok) {
+        endOpenBulkUpdate();
+        // 取消或失败时丢弃已加载的部分
+        const bool canceled = m_loader->isCanceled();
+        clearMap();
+        m_modelActive = false;
+        m_mapPath.clear();
+        if (!canceled) {
+            QMessageBox::critical(nullptr, "错误", "无法读取思维导图");
+        }
+        emit openFinished(false);
+        return;
+    }
+
+    if (m_modelActive) {
+        m_model.finish();
+        endOpenBulkUpdate();
+        if (!views().isEmpty()) m_virtualizer->attach(views().first());
+        layoutModel(true);
+        emit openFinished(true);
+        return;
+    }
+
+    // 并行扫描时兄弟节点到达顺序不定，统一按文件夹名排序
+    recursiveSortChildren(m_rootNode);
+    // 没有连线表的旧图由后台从节点文档导入，建好后再恢复连线
+    restoreLinks();
     updateLayout();
-    return true;
+    endOpenBulkUpdate();
+    m_budgetTimer->start(0);
+    emit openFinished(true);
+
+    // 按需加载只读了可见部分，缺少的索引放到后台从存储建立
+    if (!m_tagIndex.isComplete() || !m_searchIndex.isComplete() || !m_links.isComplete()) startIndexing();
 }
 
-void MindMapScene::recursiveLoadChildren(MindMapNode* parent)
+void MindMapScene::startIndexing()
 {
-    if (!parent) return;
+    if (m_indexing || !m_saveQueue->storage()) return;
 
-    QDir parentDir(parent->folderPath());
-    QFileInfoList entries = parentDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    // 先把待保存的修改交给存储（不必刷盘），之后的修改记下来等索引建好后重放
+    m_saveQueue->handOff();
+    m_indexing = true;
+    m_indexChanges.clear();
+    m_loader->buildIndexes(m_saveQueue->storage(), !m_tagIndex.isComplete(), !m_searchIndex.isComplete(),
+                           !m_links.isComplete());
+}
 
-    for (const QFileInfo& entry : entries) {
-        if (entry.isDir()) {
-            QString childPath = entry.absoluteFilePath();
+void MindMapScene::installIndexes(const QSharedPointer<MapIndexes>& indexes)
+{
+    if (!m_indexing) return;
+    if (indexes->hasTags) m_tagIndex = indexes->tags;
+    if (indexes->hasSearch) m_searchIndex = indexes->search;
+    if (indexes->hasLinks) m_links = indexes->links;
 
-            // 创建子节点
-            MindMapNode* child = new MindMapNode(entry.fileName(), childPath, parent);
-            addItem(child);
+    // 后台读到的文档可能早于也可能晚于这些修改，重放的操作都是幂等的
+    const QVector<std::function<void()>> changes = std::exchange(m_indexChanges, {});
+    m_indexing = false;
+    for (const std::function<void()>& change : changes) change();
 
-            // 添加到父节点
-            parent->addChild(child);
+    // 之后随图保存，下次打开直接读入
+    m_tagIndex.save();
+    m_searchIndex.save();
+    m_links.save();
+    if (indexes->hasLinks) restoreLinks();
+    // 建立期间请求的标签筛选现在可以执行
+    if (!m_highlightTags.isEmpty() && m_tagIndex.isComplete()) {
+        highlightByTags(m_highlightTags, m_highlightMatch, m_highlightFilter);
+    }
+    emit indexesReady();
+}
 
-            // 递归加载子节点
-            recursiveLoadChildren(child);
+void MindMapScene::recordIndexChange(const std::function<void()>& change)
+{
+    if (m_indexing) m_indexChanges.append(change);
+}
+
+void MindMapScene::clearMap()
+{
+    // 关闭时把存储整理为紧凑形式（打包格式在此合并追加日志）
+    if (QSharedPointer<MapStorage> storage = m_saveQueue->storage()) storage->compact();
+    m_tagIndex.save();
+    m_searchIndex.save();
+    m_links.save();
+    m_linkPending.clear();
+    // 尚未建好的后台索引作废（换图前加载器已中止）
+    m_indexing = false;
+    m_indexChanges.clear();
+    m_highlightTags.clear();
+
+    // 清空期间节点析构的通知不再创建连线层等
+    m_clearing = true;
+    m_virtualizer->reset();
+    m_rootNode = nullptr;
+    clear();
+    m_model.clear();
+    m_clearing = false;
+}
+
+void MindMapScene::layoutModel(bool center)
+{
+    m_centerAfterLayout = m_centerAfterLayout || center;
+
+    LayoutSnapshot snapshot = m_model.snapshot(m_layout.mode());
+    if (snapshot.size() < kAsyncLayoutThreshold) {
+        m_layoutWorker->abort();
+        LayoutEngine::compute(snapshot);
+        finishModelLayout(snapshot);
+    } else {
+        m_layoutWorker->start(snapshot);
+    }
+}
+
+void MindMapScene::finishModelLayout(const LayoutSnapshot& snapshot)
+{
+    if (!m_modelActive) return;
+
+    // 计算期间模型变了，重新计算
+    if (snapshot.generation != m_model.version()) {
+        layoutModel(false);
+        return;
+    }
+    m_model.applyLayout(snapshot);
+    if (EdgeLayer* layer = edgeLayer()) layer->markDirty();
+
+    if (m_centerAfterLayout && m_model.size() > 0 && !views().isEmpty()) {
+        views().first()->centerOn(m_model.position(0));
+    }
+    m_centerAfterLayout = false;
+    m_virtualizer->refresh();
+    if (!m_revealPath.isEmpty()) centerOnReveal();
+}
+
+void MindMapScene::endOpenBulkUpdate()
+{
+    if (!m_openBulk) return;
+    m_openBulk = false;
+    endBulkUpdate();
+}
+
+void MindMapScene::beginBulkUpdate()
+{
+    if (m_bulkDepth++ > 0) return;
+    m_indexMethod = itemIndexMethod();
+    setItemIndexMethod(NoIndex);
+}
+
+void MindMapScene::endBulkUpdate()
+{
+    if (m_bulkDepth == 0 || --m_bulkDepth > 0) return;
+
+    // 恢复索引方式即一次性重建索引
+    setItemIndexMethod(m_indexMethod);
+
+    // 期间跳过的连线更新统一补上
+    if (m_edgeLayerEnabled) {
+        edgesChanged();
+    } else {
+        for (QGraphicsItem* item : items()) {
+            if (item->type() != MindMapNode::Type) continue;
+            MindMapNode* node = static_cast<MindMapNode*>(item);
+            for (Connection* connection : node->connections()) {
+                if (connection->sourceNode() == node) connection->updatePath();
+            }
         }
     }
 }
 
-void MindMapScene::restoreConnections(MindMapNode* node)
+void MindMapScene::recursiveSortChildren(MindMapNode* node)
 {
     if (!node) return;
 
-    // 加载节点的连接信息
-    node->loadFromJson();
-
-    // 递归处理子节点
+    node->sortChildren();
     for (MindMapNode* child : node->children()) {
-        restoreConnections(child);
+        recursiveSortChildren(child);
     }
 }
 
-void MindMapScene::recursiveSave(MindMapNode* node)
+void MindMapScene::setItemBudget(int budget)
 {
-    if (!node) return;
+    m_itemBudget = budget;
+    m_budgetTimer->start(0);
+}
 
-    // 保存当前节点
-    node->saveToJson();
+void MindMapScene::nodeAdded(MindMapNode* node)
+{
+    indexNode(node);
+    // 展开、按需加载的节点补上与已加载节点之间的连线；打开时最后统一恢复
+    if (!m_links.isEmpty() && !m_modelActive && !m_clearing && !isOpening()) {
+        m_linkPending.insert(node);
+        m_linkTimer->start(0);
+    }
+    ++m_nodeCount;
+    ++m_structureVersion;
+    if (EdgeLayer* layer = syncingEdgeLayer()) layer->nodeChanged(node);
+}
 
-    // 递归保存子节点
-    for (MindMapNode* child : node->children()) {
-        recursiveSave(child);
+void MindMapScene::nodeRemoved(MindMapNode* node)
+{
+    unindexNode(node);
+    m_linkPending.remove(node);
+    --m_nodeCount;
+    ++m_structureVersion;
+    m_collapsedAt.remove(node);
+    m_layout.forget(node);
+    m_dragSession->nodeRemoved(node);
+    // 节点即将析构，批量更新中也要立即移除连线层对它的引用
+    if (m_edgeLayer && !m_clearing) m_edgeLayer->nodeRemoved(node);
+    m_saveQueue->forget(node);
+}
+
+void MindMapScene::nodePathChanged(MindMapNode* node)
+{
+    // 后代的路径由祖先拼出，一并更新
+    indexNode(node);
+    for (MindMapNode* child : node->children()) nodePathChanged(child);
+}
+
+void MindMapScene::indexNode(MindMapNode* node)
+{
+    unindexNode(node);
+    const QString path = node->folderPath();
+    if (path.isEmpty()) return; // 新建节点在挂到父节点后才有路径
+    const QString key = QDir::cleanPath(path);
+    m_nodesByPath.insert(key, node);
+    m_nodePaths.insert(node, key);
+}
+
+void MindMapScene::unindexNode(MindMapNode* node)
+{
+    // 按登记时的键删除，析构途中节点已拼不出完整路径
+    auto it = m_nodePaths.find(node);
+    if (it == m_nodePaths.end()) return;
+    if (m_nodesByPath.value(it.value()) == node) m_nodesByPath.remove(it.value());
+    m_nodePaths.erase(it);
+}
+
+MindMapNode* MindMapScene::nodeAt(const QString& folderPath) const
+{
+    return m_nodesByPath.value(QDir::cleanPath(folderPath));
+}
+
+MindMapNode* MindMapScene::linkTarget(const MindMapNode* source, const QString& link) const
+{
+    // 连接以相对源节点文件夹的路径保存
+    return nodeAt(QDir(source->folderPath()).filePath(link));
+}
+
+bool MindMapScene::linkNodes(MindMapNode* source, MindMapNode* destination)
+{
+    if (!source || !destination || source == destination) return false;
+    const QString sourcePath = source->folderPath();
+    const QString destinationPath = destination->folderPath();
+    recordIndexChange([this, sourcePath, destinationPath]() { m_links.add(sourcePath, destinationPath); });
+    if (!m_links.add(sourcePath, destinationPath)) return false;
+    // 连线表是连线的唯一存放处，修改后立即落盘
+    m_links.save();
+    connectNodes(source, destination);
+    return true;
+}
+
+bool MindMapScene::unlinkNodes(MindMapNode* source, MindMapNode* destination)
+{
+    const QString sourcePath = source->folderPath();
+    const QString destinationPath = destination->folderPath();
+    recordIndexChange([this, sourcePath, destinationPath]() { m_links.remove(sourcePath, destinationPath); });
+    if (!m_links.remove(sourcePath, destinationPath)) return false;
+    m_links.save();
+
+    const QList<Connection*> connections = source->connections();
+    for (Connection* connection : connections) {
+        if (connection->sourceNode() != source || connection->destinationNode() != destination) continue;
+        source->removeConnection(connection);
+        destination->removeConnection(connection);
+        m_itemPool.recycle(connection);
     }
+    return true;
 }
 
-bool MindMapScene::saveMap()
+void MindMapScene::connectNodes(MindMapNode* source, MindMapNode* destination)
 {
-    if (m_rootNode) {
-        // 递归保存所有节点
-        recursiveSave(m_rootNode);
-        return true;
+    for (Connection* connection : source->connections()) {
+        if (connection->sourceNode() == source && connection->destinationNode() == destination) return;
+    }
+
+    // 合并绘制时只登记关系，否则作为顶层图形项
+    Connection* connection = m_itemPool.takeConnection(source, destination, nullptr);
+    if (!m_edgeLayerEnabled) {
+        addItem(connection);
+        connection->updatePath();
+    } else if (EdgeLayer* layer = syncingEdgeLayer()) {
+        layer->linkChanged(connection);
     }
-    return false;
 }
 
+void MindMapScene::restoreLinks()
+{
+    if (m_links.isEmpty() || m_modelActive) return;
 
+    // 每个端点只按路径解析一次，之后按编号取用
+    QVector<MindMapNode*> nodes;
+    nodes.reserve(m_links.nodeCount());
+    for (int id = 0; id < m_links.nodeCount(); ++id) nodes.append(nodeAt(m_links.path(id)));
 
-void MindMapScene::updateLayout()
+    BulkUpdate bulk(this);
+    for (const LinkTable::Link& link : m_links.links()) {
+        MindMapNode* source = nodes[link.source];
+        MindMapNode* destination = nodes[link.destination];
+        if (source && destination) connectNodes(source, destination);
+    }
+}
+
+void MindMapScene::restorePendingLinks()
+{
+    const QSet<MindMapNode*> pending = std::exchange(m_linkPending, {});
+    if (m_links.isEmpty()) return;
+
+    const QVector<LinkTable::Link>& links = m_links.links();
+    for (MindMapNode* node : pending) {
+        const int id = m_links.nodeId(node->folderPath());
+        if (id < 0) continue;
+        for (int i : m_links.outgoing(id)) {
+            if (MindMapNode* destination = nodeAt(m_links.path(links[i].destination))) connectNodes(node, destination);
+        }
+        for (int i : m_links.incoming(id)) {
+            if (MindMapNode* source = nodeAt(m_links.path(links[i].source))) connectNodes(source, node);
+        }
+    }
+}
+
+void MindMapScene::nodeExpandedChanged(MindMapNode* node)
+{
+    ++m_structureVersion;
+
+    // 虚拟化时改模型后重排，视口内的图形项随之更新
+    if (node->modelIndex() >= 0) {
+        m_model.setExpanded(node->modelIndex(), node->isExpanded());
+        layoutModel(false);
+        return;
+    }
+    if (node->isExpanded()) {
+        m_collapsedAt.remove(node);
+    } else if (node->hasChildren()) {
+        m_collapsedAt.insert(node, m_clock.elapsed());
+    }
+
+    // 合并到一次检查，避免全部折叠时逐个排序
+    if (!m_budgetTimer->isActive()) m_budgetTimer->start(0);
+    // 子树中的连线随展开折叠出现或消失
+    if (EdgeLayer* layer = syncingEdgeLayer()) layer->nodeChanged(node);
+
+    // 折叠/展开改变子树占用的行数
+    nodeStructureChanged(node);
+}
+
+void MindMapScene::nodeMoved(MindMapNode* node)
+{
+    // 子节点随之移动，同步整棵子树上的连线
+    if (EdgeLayer* layer = syncingEdgeLayer()) layer->nodeChanged(node);
+}
+
+void MindMapScene::connectionMoved(const Connection* connection)
+{
+    if (EdgeLayer* layer = syncingEdgeLayer()) layer->linkChanged(connection);
+}
+
+void MindMapScene::connectionRemoved(const Connection* connection)
+{
+    // 连线即将回收或析构，批量更新中也要立即移除
+    if (m_edgeLayer && !m_clearing) m_edgeLayer->linkRemoved(connection);
+}
+
+void MindMapScene::edgesChanged()
+{
+    // 批量更新结束时统一重建；虚拟化时连线来自模型，与图形项无关
+    if (!m_rootNode || m_modelActive || isBulkUpdating()) return;
+    if (EdgeLayer* layer = edgeLayer()) layer->markDirty();
+}
+
+EdgeLayer* MindMapScene::syncingEdgeLayer()
+{
+    // 批量更新结束时会整体重建，期间不必逐条同步
+    if (!m_rootNode || m_modelActive || isBulkUpdating()) return nullptr;
+    return edgeLayer();
+}
+
+EdgeLayer* MindMapScene::edgeLayer()
+{
+    if (!m_edgeLayerEnabled || m_clearing) return nullptr;
+    if (!m_edgeLayer) {
+        m_edgeLayer = new EdgeLayer();
+        addItem(m_edgeLayer);
+    }
+    m_edgeLayer->setModel(m_modelActive ? &m_model : nullptr);
+    return m_edgeLayer;
+}
+
+void MindMapScene::setEdgeLayerEnabled(bool enabled)
+{
+    if (m_edgeLayerEnabled == enabled) return;
+    m_edgeLayerEnabled = enabled;
+
+    // 逐条连线在两种模式间迁移：合并绘制时连线对象不在场景中
+    for (QGraphicsItem* item : items()) {
+        if (item->type() != MindMapNode::Type) continue;
+        MindMapNode* node = static_cast<MindMapNode*>(item);
+        for (Connection* connection : node->connections()) {
+            if (connection->sourceNode() != node) continue;
+            if (enabled) {
+                if (connection->scene()) removeItem(connection);
+            } else if (!connection->scene()) {
+                MindMapNode* destination = connection->destinationNode();
+                if (destination && destination->parentNode() == node) {
+                    connection->setParentItem(node);
+                    connection->setVisible(node->isExpanded());
+                } else {
+                    addItem(connection);
+                }
+                connection->updatePath();
+            }
+        }
+    }
+
+    if (enabled) {
+        if (m_modelActive) {
+            if (EdgeLayer* layer = edgeLayer()) layer->markDirty();
+        } else {
+            edgesChanged();
+        }
+    } else if (m_edgeLayer) {
+        delete m_edgeLayer;
+    }
+}
+
+void MindMapScene::nodeStructureChanged(MindMapNode* node)
+{
+    if (node->modelIndex() >= 0) {
+        m_model.setText(node->modelIndex(), node->text());
+        layoutModel(false);
+        return;
+    }
+
+    if (isOpening()) return; // 加载完成后统一全量布局
+    m_layout.invalidate(node);
+    scheduleLayout();
+}
+
+void MindMapScene::scheduleLayout()
+{
+    if (!m_layoutTimer->isActive()) m_layoutTimer->start(0);
+}
+
+void MindMapScene::applyLayout()
+{
+    // 后台全量布局完成时会覆盖全部位置，不必先做增量
+    if (m_layoutWorker->isRunning()) return;
+
+    // 只重排失效节点的子节点，并平移其后的兄弟子树
+    if (!m_layout.update(m_rootNode)) startFullLayout(false);
+}
+
+void MindMapScene::startFullLayout(bool center)
 {
     if (!m_rootNode) return;
+    m_layoutTimer->stop();
+    m_centerAfterLayout = m_centerAfterLayout || center;
 
-    // 重置所有节点位置
-    qreal y = 0;
-    recursiveLayout(m_rootNode, 0, y, 0);
+    // 小图直接在当前线程完成
+    if (m_nodeCount < kAsyncLayoutThreshold) {
+        m_layoutWorker->abort();
+        BulkUpdate bulk(this);
+        m_layout.layoutAll(m_rootNode);
+        finishFullLayout(LayoutSnapshot());
+        return;
+    }
+
+    // 大图只在GUI线程拍扁平快照，计算交给后台
+    LayoutSnapshot snapshot = m_layout.snapshot(m_rootNode);
+    snapshot.generation = m_structureVersion;
+    m_layoutWorker->start(snapshot);
+}
+
+void MindMapScene::finishFullLayout(const LayoutSnapshot& snapshot)
+{
+    // 模型快照（source 非空）走虚拟化的布局流程
+    if (!snapshot.source.isEmpty()) {
+        finishModelLayout(snapshot);
+        return;
+    }
+
+    if (snapshot.size() > 0) {
+        // 计算期间树结构变了，快照里的指针可能已失效，重新计算
+        if (snapshot.generation != m_structureVersion) {
+            startFullLayout(false);
+            return;
+        }
+        BulkUpdate bulk(this);
+        m_layout.apply(snapshot);
+    }
 
     // 更新视图
-    if (!views().isEmpty()) {
+    if (m_centerAfterLayout && m_rootNode && !views().isEmpty()) {
         views().first()->centerOn(m_rootNode);
     }
+    m_centerAfterLayout = false;
+    if (!m_revealPath.isEmpty()) centerOnReveal();
 }
 
-void MindMapScene::recursiveLayout(MindMapNode* node, qreal x, qreal& y, int depth)
+void MindMapScene::enforceItemBudget()
 {
-    if (!node->isExpanded()) return;
+    if (m_nodeCount <= m_itemBudget || isOpening()) return;
 
-    // 设置当前节点位置
-    node->setPosition(QPointF(x, y));
-    y += 80; // 垂直间距
+    // 按折叠时间从早到晚释放子树
+    QList<QPair<qint64, MindMapNode*>> candidates;
+    candidates.reserve(m_collapsedAt.size());
+    for (auto it = m_collapsedAt.cbegin(); it != m_collapsedAt.cend(); ++it) {
+        candidates.append(qMakePair(it.value(), it.key()));
+    }
+    std::sort(candidates.begin(), candidates.end());
 
-    // 布局子节点
-    qreal childX = x + 200; // 水平缩进
-    for (MindMapNode* child : node->children()) {
-        recursiveLayout(child, childX, y, depth + 1);
+    const qint64 now = m_clock.elapsed();
+    for (const auto& candidate : std::as_const(candidates)) {
+        if (m_nodeCount <= m_itemBudget) return;
+
+        // 已随更早释放的祖先一起删除
+        MindMapNode* node = candidate.second;
+        if (!m_collapsedAt.contains(node)) continue;
+
+        const qint64 age = now - candidate.first;
+        if (age < kMinCollapsedAge) {
+            m_budgetTimer->start(int(kMinCollapsedAge - age));
+            return;
+        }
+
+        m_collapsedAt.remove(node);
+        node->hideAllChild();
+    }
+}
+
+int MindMapScene::saveMap()
+{
+    if (!m_rootNode && !m_modelActive) return -1;
+
+    // 存储格式变化时切换后端，全部节点写入新后端
+    int written = 0;
+    bool converted = false;
+    QSharedPointer<MapStorage> previous = m_saveQueue->storage();
+    if (!previous || previous->format() != m_format) {
+        flushPending();
+        QSharedPointer<MapStorage> next = MapStorage::create(m_format, m_mapPath);
+        // 尚未加载为图形项的节点也要带到新后端；复制失败时继续使用原后端
+        const int copied = previous ? MapStorage::copy(*previous, *next) : 0;
+        if (copied >= 0) {
+            written = copied;
+            converted = true;
+            m_saveQueue->setStorage(next);
+        } else {
+            qWarning() << "转换存储格式失败，仍使用原格式:" << m_mapPath;
+            m_format = previous->format();
+        }
+    }
+
+    // 修改过的节点都已在延迟写入队列中，只写出这些节点，内容未变的也会跳过；
+    // 报告的是上次保存以来落盘的节点，转换格式时报告复制的节点
+    m_saveQueue->flush();
+    const int saved = m_saveQueue->takeWrittenCount();
+    if (!converted) written = saved;
+    m_saveQueue->storage()->compact();
+    m_tagIndex.save();
+    m_searchIndex.save();
+    m_links.save();
+
+    // 转回文件夹格式后移除旧的打包文件
+    if (converted && previous && previous->format() == MapStorage::PackedFormat && m_format == MapStorage::FolderFormat) {
+        QFile::remove(QDir(m_mapPath).filePath(PackedStorage::fileName()));
+        QFile::remove(QDir(m_mapPath).filePath(PackedStorage::logFileName()));
+    }
+    return written;
+}
+
+
+
+void MindMapScene::setLayoutMode(LayoutMode mode)
+{
+    if (m_layout.mode() == mode) return;
+    m_layout.setMode(mode);
+    updateLayout();
+}
+
+void MindMapScene::updateLayout()
+{
+    if (m_modelActive) {
+        layoutModel(true);
+        return;
     }
+
+    // 重置所有节点位置，并重建子树行数缓存
+    startFullLayout(true);
+}
+
+bool MindMapScene::event(QEvent* event)
+{
+    // 字体变化后节点缓存的文字度量失效，重新测量并重排
+    if (event->type() == QEvent::FontChange) {
+        for (QGraphicsItem* item : items()) {
+            if (item->type() == MindMapNode::Type) static_cast<MindMapNode*>(item)->updateGeometry();
+        }
+        if (m_layout.mode() != OutlineLayout) updateLayout();
+    }
+    return QGraphicsScene::event(event);
 }
 
 void MindMapScene::mousePressEvent(QGraphicsSceneMouseEvent* event)
@@ -190,20 +923,23 @@ MindMapNode* MindMapScene::addChildNode(MindMapNode* parent, const QString& text
 {
     if (!parent) return nullptr;
 
-    // 创建子节点
-    MindMapNode* child = new MindMapNode(text, "");
-    addItem(child);
+    // 先展开父节点，新节点才可见
+    if (!parent->isExpanded()) parent->setExpanded(true);
+
+    // 创建子节点，坐标相对父节点；文件夹由 addChild 创建
+    NodeRecord record;
+    record.name = text;
+    MindMapNode* child = m_itemPool.takeNode(record, parent);
 
-    // 创建连接
-    Connection* connection = new Connection(parent, child);
-    addItem(connection);
-    connection->updatePath();
+    // 创建连接：合并绘制时只登记关系，否则挂在父节点下随子树移动
+    m_itemPool.takeConnection(parent, child, m_edgeLayerEnabled ? nullptr : parent);
 
     // 添加父子关系
     parent->addChild(child);
+    nodeTextChanged(child);
 
-    // 更新布局
-    updateLayout();
+    // 只重排父节点的子节点并平移后续子树
+    nodeStructureChanged(parent);
 
     return child;
 }
@@ -215,13 +951,16 @@ void MindMapScene::showNodeContextMenu(MindMapNode* node, const QPoint& screenPo
     QAction* editAction = menu.addAction("编辑节点");
     QAction* deleteAction = menu.addAction("删除节点");
     QAction* colorAction = menu.addAction("设置颜色");
+    QAction* addTagAction = menu.addAction("添加标签");
+    QAction* removeTagAction = menu.addAction("移除标签");
+    removeTagAction->setEnabled(!node->tagIds().isEmpty());
     menu.addSeparator();
 
     // 折叠/展开操作
     QAction* expandAction = nullptr;
     QAction* collapseAction = nullptr;
 
-    if (!node->children().isEmpty()) {
+    if (node->hasChildren()) {
         if (node->isExpanded()) {
             collapseAction = menu.addAction("折叠子节点");
         } else {
@@ -236,10 +975,28 @@ void MindMapScene::showNodeContextMenu(MindMapNode* node, const QPoint& screenPo
     menu.addSeparator();
     QAction* openFolderAction = menu.addAction("打开文件夹");
 
-    // 根节点不能被删除
+    // 另选中一个节点时可以在两者之间建立或断开连线
+    MindMapNode* other = nullptr;
+    const QList<QGraphicsItem*> selected = selectedItems();
+    if (selected.size() == 1 || (selected.size() == 2 && selected.contains(node))) {
+        for (QGraphicsItem* item : selected) {
+            if (item != node && item->type() == MindMapNode::Type) other = static_cast<MindMapNode*>(item);
+        }
+    }
+    menu.addSeparator();
+    QAction* linkAction = menu.addAction("连接到选中节点");
+    QAction* unlinkAction = menu.addAction("断开与选中节点的连线");
+    linkAction->setEnabled(other && node->modelIndex() < 0);
+    unlinkAction->setEnabled(other && node->modelIndex() < 0);
+
+    // 根节点不能被删除；虚拟化显示时不能增删节点
     if (node->isRoot()) {
         deleteAction->setEnabled(false);
     }
+    if (node->modelIndex() >= 0) {
+        deleteAction->setEnabled(false);
+        addChildAction->setEnabled(false);
+    }
 
     QAction* selectedAction = menu.exec(screenPos);
 
@@ -249,17 +1006,28 @@ void MindMapScene::showNodeContextMenu(MindMapNode* node, const QPoint& screenPo
                                            QLineEdit::Normal, node->text(), &ok);
         if (ok && !text.isEmpty()) {
             node->setText(text);
-            updateLayout();
+            // 宽度变化只影响紧凑树布局，大纲布局下重排子节点即可
+            nodeStructureChanged(node);
         }
     }
     else if (selectedAction == deleteAction && !node->isRoot()) {
         // 删除节点及其所有连接
         removeNode(node);
-        updateLayout();
     }
     else if (selectedAction == colorAction) {
         node->setColor(QColor(rand() % 256, rand() % 256, rand() % 256));
     }
+    else if (selectedAction == addTagAction) {
+        bool ok;
+        QString tag = QInputDialog::getText(nullptr, "添加标签", "输入标签:",
+                                          QLineEdit::Normal, QString(), &ok).trimmed();
+        if (ok && !tag.isEmpty()) node->addTag(tag);
+    }
+    else if (selectedAction == removeTagAction) {
+        bool ok;
+        QString tag = QInputDialog::getItem(nullptr, "移除标签", "选择标签:", node->tags(), 0, false, &ok);
+        if (ok && !tag.isEmpty()) node->removeTag(tag);
+    }
     else if (selectedAction == addChildAction) {
         bool ok;
         QString text = QInputDialog::getText(nullptr, "添加子节点", "输入节点内容:",
@@ -268,6 +1036,12 @@ void MindMapScene::showNodeContextMenu(MindMapNode* node, const QPoint& screenPo
             addChildNode(node, text);
         }
     }
+    else if (selectedAction == linkAction) {
+        linkNodes(node, other);
+    }
+    else if (selectedAction == unlinkAction) {
+        if (!unlinkNodes(node, other)) unlinkNodes(other, node);
+    }
     else if (selectedAction == openFolderAction) {
         if (!node->folderPath().isEmpty()) {
             QDesktopServices::openUrl(QUrl::fromLocalFile(node->folderPath()));
@@ -275,15 +1049,12 @@ void MindMapScene::showNodeContextMenu(MindMapNode* node, const QPoint& screenPo
     }
     else if (selectedAction == expandAction) {
         node->setExpanded(true);
-        updateLayout();
     }
     else if (selectedAction == collapseAction) {
         node->setExpanded(false);
-        updateLayout();
     }
     else if (selectedAction && selectedAction->text() == "切换折叠/展开") {
         node->toggleExpanded();
-        updateLayout();
     }
 }
 
@@ -315,21 +1086,252 @@ void MindMapScene::showSceneContextMenu(const QPoint& screenPos, const QPointF&
         }
     }
     else if (selectedAction == saveAction) {
-        saveMap();
-        QMessageBox::information(nullptr, "保存成功", "思维导图已保存到文件系统");
+        const int written = saveMap();
+        if (written >= 0) {
+            QMessageBox::information(nullptr, "保存成功", QString("思维导图已保存，写入 %1 个节点").arg(written));
+        }
+    }
+    else if (selectedAction == expandAllAction) {
+        setAllExpanded(true);
+    }
+    else if (selectedAction == collapseAllAction) {
+        setAllExpanded(false);
+    }
+}
+
+namespace {
+// Qt 6 字符串的堆占用：数据头约 16 字节，加上 UTF-16 内容和结尾
+qint64 stringBytes(const QString& text)
+{
+    return text.isEmpty() ? 0 : 16 + (qint64(text.size()) + 1) * 2;
+}
+
+// QJsonObject 的堆占用估算：容器头、每个键值对两个 16 字节元素，加上字符串内容
+qint64 jsonBytes(const QJsonObject& json)
+{
+    if (json.isEmpty()) return sizeof(QJsonObject);
+    return sizeof(QJsonObject) + 32 + json.size() * 32 + QJsonDocument(json).toJson(QJsonDocument::Compact).size();
+}
+}
+
+QString MindMapScene::memoryReport() const
+{
+    qint64 nodes = 0;
+    qint64 legacy = 0;    // 绝对路径、标签字符串列表、QColor、完整的节点文档
+    qint64 compact = 0;   // 路径段、标签编号、调色板下标、只含其余字段的节点文档
+    for (QGraphicsItem* item : items()) {
+        if (item->type() != MindMapNode::Type) continue;
+        const MindMapNode* node = static_cast<const MindMapNode*>(item);
+        ++nodes;
+
+        const QString path = node->folderPath();
+        const QStringList tags = node->tags();
+        legacy += sizeof(QString) + stringBytes(path);
+        legacy += sizeof(QList<QString>) + (tags.isEmpty() ? 0 : 16 + tags.size() * qint64(sizeof(QString)));
+        for (const QString& tag : tags) legacy += stringBytes(tag);
+        legacy += sizeof(QColor);
+        legacy += jsonBytes(node->toJson());
+
+        // 相对路径段与驻留表共享数据，计入下面的共享部分
+        compact += sizeof(QString) + sizeof(bool);
+        if (node->isRoot()) compact += stringBytes(path);
+        compact += sizeof(QList<quint32>) + (tags.isEmpty() ? 0 : 16 + tags.size() * qint64(sizeof(quint32)));
+        compact += sizeof(quint16);
+        compact += jsonBytes(node->document());
+    }
+    if (nodes == 0) return "没有已加载的节点";
+
+    const qint64 shared = SymbolTable::segments().bytes() + SymbolTable::tags().bytes()
+        + ColorPalette::size() * qint64(sizeof(QRgb) + sizeof(QRgb) + sizeof(quint16) + sizeof(void*));
+    return QString("已加载节点：%1\n"
+                   "路径、标签、颜色字段和节点文档（字节/节点）\n"
+                   "  驻留前：%2\n"
+                   "  驻留后：%3（其中共享表 %4）\n"
+                   "路径段驻留表：%5 项，标签表：%6 项，调色板：%7 色")
+        .arg(nodes)
+        .arg(double(legacy) / nodes, 0, 'f', 1)
+        .arg(double(compact + shared) / nodes, 0, 'f', 1)
+        .arg(double(shared) / nodes, 0, 'f', 1)
+        .arg(SymbolTable::segments().size())
+        .arg(SymbolTable::tags().size())
+        .arg(ColorPalette::size());
+}
+
+void MindMapScene::nodeTagChanged(MindMapNode* node, const QString& tag, bool added)
+{
+    // 索引不完整时之后会从存储整体重建，不必逐条维护
+    nodeTextChanged(node);
+    const QString path = node->folderPath();
+    recordIndexChange([this, path, tag, added]() {
+        if (added) m_tagIndex.add(path, tag);
+        else m_tagIndex.remove(path, tag);
+    });
+    if (!m_tagIndex.isComplete()) return;
+    if (added) m_tagIndex.add(path, tag);
+    else m_tagIndex.remove(path, tag);
+}
+
+void MindMapScene::nodeTextChanged(MindMapNode* node)
+{
+    const QString path = node->folderPath();
+    const QString text = node->text();
+    const QStringList tags = node->tags();
+    recordIndexChange([this, path, text, tags]() { m_searchIndex.update(path, text, tags); });
+    if (m_searchIndex.isComplete()) m_searchIndex.update(path, text, tags);
+}
+
+QStringList MindMapScene::search(const QString& text, int limit)
+{
+    // 边输入边搜索，不在界面线程上等待或同步建立索引；交给后台建立，建好后发出 indexesReady
+    if (!m_searchIndex.isComplete()) {
+        startIndexing();
+        return QStringList();
+    }
+    return m_searchIndex.search(text, limit);
+}
+
+bool MindMapScene::revealNode(const QString& folderPath)
+{
+    if (m_modelActive) {
+        // 虚拟化时在模型中展开祖先，布局完成后定位
+        const int index = m_model.find(folderPath);
+        if (index < 0) return false;
+        for (int i = m_model.parent(index); i >= 0; i = m_model.parent(i)) m_model.setExpanded(i, true);
+        m_revealPath = folderPath;
+        layoutModel(false);
+        return true;
+    }
+
+    MindMapNode* node = findNode(folderPath, true);
+    if (!node) return false;
+
+    // 先完成展开引起的重排再定位；后台全量布局时在完成后定位
+    m_revealPath = folderPath;
+    applyLayout();
+    if (!m_layoutWorker->isRunning()) centerOnReveal();
+    return true;
+}
+
+MindMapNode* MindMapScene::findNode(const QString& folderPath, bool expand)
+{
+    if (MindMapNode* node = nodeAt(folderPath)) {
+        if (expand) {
+            for (MindMapNode* parent = node->parentNode(); parent; parent = parent->parentNode()) {
+                if (!parent->isExpanded()) parent->setExpanded(true);
+            }
+        }
+        return node;
+    }
+    if (!expand || !m_rootNode) return nullptr;
+
+    // 尚未加载：从根逐层展开，折叠的祖先展开后才会加载子节点
+    const QString rel = QDir(m_rootNode->folderPath()).relativeFilePath(folderPath);
+    MindMapNode* node = m_rootNode;
+    for (const QString& name : rel.split('/', Qt::SkipEmptyParts)) {
+        if (!node->isExpanded()) node->setExpanded(true);
+        MindMapNode* next = node->child(name);
+        if (!next) {
+            node->loadChild(name);
+            next = node->child(name);
+        }
+        if (!next) return nullptr;
+        node = next;
+    }
+    return node;
+}
+
+void MindMapScene::centerOnReveal()
+{
+    const QString path = m_revealPath;
+    m_revealPath.clear();
+    if (path.isEmpty() || views().isEmpty()) return;
+
+    if (m_modelActive) {
+        const int index = m_model.find(path);
+        if (index >= 0) views().first()->centerOn(m_model.position(index));
+        m_virtualizer->refresh();
+        if (MindMapNode* node = m_virtualizer->item(index)) {
+            clearSelection();
+            node->setSelected(true);
+        }
+        return;
+    }
+
+    if (MindMapNode* node = findNode(path, false)) {
+        clearSelection();
+        node->setSelected(true);
+        views().first()->centerOn(node);
+    }
+}
+
+QStringList MindMapScene::findByTags(const QStringList& tags, TagIndex::Match match)
+{
+    // 不在界面线程上等待或同步建立索引，交给后台建立，建好后发出 indexesReady
+    if (!m_tagIndex.isComplete()) {
+        startIndexing();
+        return QStringList();
+    }
+    return m_tagIndex.query(tags, match);
+}
+
+int MindMapScene::highlightByTags(const QStringList& tags, TagIndex::Match match, bool filter)
+{
+    const QStringList paths = tags.isEmpty() ? QStringList() : findByTags(tags, match);
+    // 索引还没建好：记下请求，保持当前显示，建好后由 installIndexes 重新执行
+    m_highlightTags.clear();
+    if (!tags.isEmpty() && !m_tagIndex.isComplete()) {
+        m_highlightTags = tags;
+        m_highlightMatch = match;
+        m_highlightFilter = filter;
+        return 0;
     }
-    else if (selectedAction == expandAllAction && m_rootNode) {
-        recursiveSetExpanded(m_rootNode, true);
-        updateLayout();
+
+    const QSet<QString> matches(paths.cbegin(), paths.cend());
+
+    // 选中已加载的匹配节点；筛选时淡化其余节点，标签为空时恢复
+    BulkUpdate bulk(this);
+    clearSelection();
+    if (m_rootNode) {
+        markTagMatches(m_rootNode, m_rootNode->folderPath(), matches, filter && !tags.isEmpty());
+    } else {
+        for (QGraphicsItem* item : items()) {
+            if (item->type() != MindMapNode::Type) continue;
+            MindMapNode* node = static_cast<MindMapNode*>(item);
+            const bool hit = matches.contains(node->folderPath());
+            node->setSelected(hit);
+            node->setDimmed(filter && !tags.isEmpty() && !hit);
+        }
     }
-    else if (selectedAction == collapseAllAction && m_rootNode) {
-        recursiveSetExpanded(m_rootNode, false);
-        updateLayout();
+    return paths.size();
+}
+
+void MindMapScene::markTagMatches(MindMapNode* node, const QString& path, const QSet<QString>& matches, bool filter)
+{
+    // 路径沿树向下拼接，不必为每个节点从根重新拼出绝对路径
+    const bool hit = matches.contains(path);
+    if (hit) node->setSelected(true);
+    // 只淡化节点自身，匹配的节点即使在被淡化的祖先之下也完整显示
+    node->setDimmed(filter && !hit);
+
+    for (MindMapNode* child : node->children()) {
+        markTagMatches(child, path + '/' + child->folderName(), matches, filter);
     }
 }
 
+void MindMapScene::setAllExpanded(bool expanded)
+{
+    // 虚拟化时只改模型中的显示状态，不逐个写回节点文档
+    if (m_modelActive) {
+        m_model.setAllExpanded(expanded);
+        layoutModel(false);
+        return;
+    }
+    if (m_rootNode) recursiveSetExpanded(m_rootNode, expanded);
+}
+
 void MindMapScene::recursiveSetExpanded(MindMapNode* node, bool expanded)
 {
+    BulkUpdate bulk(this);
     node->setExpanded(expanded);
     for (MindMapNode* child : node->children()) {
         recursiveSetExpanded(child, expanded);
@@ -340,25 +1342,19 @@ void MindMapScene::removeNode(MindMapNode* node)
 {
     if (!node || node->isRoot()) return;
 
-    // 递归删除子节点
-    QList<MindMapNode*> children = node->children();
-    for (MindMapNode* child : children) {
-        removeNode(child);
-    }
-
-    // 删除连接
-    QList<Connection*> connections = node->connections();
-    for (Connection* connection : connections) {
-        removeItem(connection);
-        delete connection;
-    }
+    // 由父节点删除文件夹、文档以及整棵子树的图形项和连接线
+    const QString path = node->folderPath();
+    recordIndexChange([this, path]() {
+        m_tagIndex.removeTree(path);
+        m_searchIndex.removeTree(path);
+        m_links.removeTree(path);
+    });
+    m_tagIndex.removeTree(path);
+    m_searchIndex.removeTree(path);
+    m_links.removeTree(path);
+    m_links.save();
+    MindMapNode* parent = node->parentNode();
+    parent->removeChild(node->folderName());
 
-    // 从父节点中移除
-    if (node->parentNode()) {
-        node->parentNode()->removeChild(node);
-    }
-
-    // 删除节点本身
-    removeItem(node);
-    delete node;
-}
\ No newline at end of file
+    nodeStructureChanged(parent);
+}
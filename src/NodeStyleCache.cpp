@@ -0,0 +1,77 @@
+#include "NodeStyleCache.h"
+#include <QPainter>
+#include <QLinearGradient>
+#include <QPen>
+#include <QtMath>
+
+namespace {
+const int kWidthBucket = 8;     // 宽度按8像素分档
+const int kHeightBucket = 4;    // 高度按4像素分档
+const int kMaxWidth = 4095;     // 键中宽12位、高10位
+const int kMaxHeight = 1023;
+}
+
+NodeStyleCache::NodeStyleCache(int maxKilobytes)
+    : m_cache(maxKilobytes)
+{
+}
+
+QSize NodeStyleCache::bucketSize(const QSizeF& size)
+{
+    return QSize(qMax(1, qCeil(size.width() / kWidthBucket)) * kWidthBucket,
+                 qMax(1, qCeil(size.height() / kHeightBucket)) * kHeightBucket);
+}
+
+QPixmap NodeStyleCache::background(const QColor& color, const QSizeF& size, int state, qreal devicePixelRatio)
+{
+    const QSize bucket = bucketSize(size);
+    const int width = bucket.width();
+    const int height = bucket.height();
+    // 截断到键的位宽会让不同尺寸共用一张图，这么大的节点不缓存
+    if (width > kMaxWidth || height > kMaxHeight) return QPixmap();
+    const int ratio = qBound(1, qRound(devicePixelRatio * 4), 255); // 以1/4为单位
+
+    // 颜色32位 | 宽12位 | 高10位 | 状态2位 | 像素比8位
+    const quint64 key = quint64(color.rgba())
+                      | (quint64(width) << 32)
+                      | (quint64(height) << 44)
+                      | (quint64(state & 3) << 54)
+                      | (quint64(ratio) << 56);
+
+    if (QPixmap* cached = m_cache.object(key)) return *cached;
+
+    const qreal dpr = ratio / 4.0;
+    QPixmap* pixmap = new QPixmap(qCeil(width * dpr), qCeil(height * dpr));
+    pixmap->setDevicePixelRatio(dpr);
+    pixmap->fill(Qt::transparent);
+    {
+        QPainter painter(pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        paintBackground(&painter, QRectF(0, 0, width, height).adjusted(1, 1, -1, -1), color, state);
+    }
+
+    const QPixmap result = *pixmap;
+    const int cost = qMax(1, pixmap->width() * pixmap->height() * 4 / 1024);
+    m_cache.insert(key, pixmap, cost);
+    return result;
+}
+
+void NodeStyleCache::paintBackground(QPainter* painter, const QRectF& rect, const QColor& color, int state)
+{
+    const bool selected = state & Selected;
+
+    QLinearGradient gradient(rect.topLeft(), rect.bottomRight());
+    gradient.setColorAt(0, color.lighter(120));
+    gradient.setColorAt(1, color);
+
+    painter->setBrush(gradient);
+    painter->setPen(QPen(selected ? Qt::blue : Qt::darkGray, selected ? 2 : 1));
+    painter->drawRoundedRect(rect, 10, 10);
+}
+
+void NodeStyleCache::paintHover(QPainter* painter, const QRectF& rect)
+{
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(255, 255, 255, 100));
+    painter->drawRoundedRect(rect, 10, 10);
+}
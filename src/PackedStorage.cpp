@@ -0,0 +1,401 @@
+#include "PackedStorage.h"
+#include <QtGlobal>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QCborValue>
+#include <QCborArray>
+#include <QCborMap>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const char kMagic[4] = { 'M', 'M', 'P', 'K' };
+const quint32 kVersion = 2;          // 版本 1 没有代数字段，仍可读取
+const qint64 kHeaderSizeV1 = 16;     // 魔数 + 版本 + 索引偏移
+const qint64 kHeaderSize = 24;       // 另加代数
+
+const char kLogMagic[4] = { 'M', 'M', 'P', 'L' };
+const qint64 kLogHeaderSize = 12;    // 魔数 + 代数
+enum LogOp { LogPut = 0, LogRemoveTree = 1 };
+
+// 追加日志超过打包文件的一半（且不小于此值）时整体重写
+const qint64 kMinCompactLog = 1 << 20;
+
+void appendRecord(QByteArray& out, LogOp op, const QString& rel, const QByteArray& bytes)
+{
+    const QByteArray record = QCborValue(QCborArray{ int(op), rel, bytes }).toCbor();
+    char length[4];
+    qToLittleEndian<quint32>(quint32(record.size()), length);
+    out.append(length, 4);
+    out.append(record);
+}
+
+bool syncHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    return _commit(handle) == 0;
+#else
+    return ::fsync(handle) == 0;
+#endif
+}
+}
+
+PackedStorage::PackedStorage(const QString& rootPath)
+    : MapStorage(rootPath), m_generation(0), m_packSize(0), m_logSize(0), m_loaded(false), m_modified(false)
+{
+}
+
+QString PackedStorage::filePath() const
+{
+    return QDir(m_rootPath).filePath(fileName());
+}
+
+QString PackedStorage::logFilePath() const
+{
+    return QDir(m_rootPath).filePath(logFileName());
+}
+
+QString PackedStorage::relativePath(const QString& folderPath) const
+{
+    QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    return rel == "." ? QString() : rel;
+}
+
+QString PackedStorage::parentOf(const QString& rel)
+{
+    return rel.contains('/') ? rel.section('/', 0, -2) : QString();
+}
+
+bool PackedStorage::load(QList<NodeRecord>& records)
+{
+    QMutexLocker locker(&m_mutex);
+    // 已读入时以内存为准：后台建索引时可能还有没落盘的写入
+    if (m_loaded) {
+        buildTree(&records);
+        return !records.isEmpty();
+    }
+    if (!readPack()) return false;
+    readLog();
+    buildTree(&records);
+    m_loaded = true;
+    m_written.clear();
+    m_removed.clear();
+    m_modified = false;
+    return !records.isEmpty();
+}
+
+void PackedStorage::ensureLoaded() const
+{
+    // 调用方已持有锁；按需读入已有的打包文件，避免覆盖未加载的节点
+    if (m_loaded) return;
+    if (QFile::exists(filePath()) && readPack()) {
+        readLog();
+        buildTree(nullptr);
+    }
+    m_loaded = true;
+}
+
+bool PackedStorage::readPack() const
+{
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法打开文件读取:" << file.fileName();
+        return false;
+    }
+
+    // 优先映射整个文件，映射失败时退回一次性读取
+    const qint64 size = file.size();
+    QByteArray buffer;
+    const char* data = reinterpret_cast<const char*>(file.map(0, size));
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+    }
+
+    if (size < kHeaderSizeV1 || memcmp(data, kMagic, 4) != 0) {
+        qWarning() << "无效的打包文件:" << file.fileName();
+        return false;
+    }
+    const quint32 version = qFromLittleEndian<quint32>(data + 4);
+    const qint64 headerSize = version == 1 ? kHeaderSizeV1 : kHeaderSize;
+    if ((version != 1 && version != kVersion) || size < headerSize) {
+        qWarning() << "无效的打包文件:" << file.fileName();
+        return false;
+    }
+
+    const qint64 indexOffset = qFromLittleEndian<quint64>(data + 8);
+    if (indexOffset < headerSize || indexOffset > size) {
+        qWarning() << "打包文件索引损坏:" << file.fileName();
+        return false;
+    }
+
+    QCborArray index = QCborValue::fromCbor(
+        QByteArray::fromRawData(data + indexOffset, size - indexOffset)).toArray();
+
+    m_entries.clear();
+    m_entries.reserve(index.size());
+    for (const QCborValue& value : index) {
+        QCborArray entry = value.toArray();
+        const qint64 offset = entry.at(1).toInteger();
+        const qint64 length = entry.at(2).toInteger();
+        if (offset < headerSize || length < 0 || offset + length > indexOffset) continue;
+        m_entries.insert(entry.at(0).toString(), QByteArray(data + offset, length));
+    }
+    m_generation = version == 1 ? 0 : qFromLittleEndian<quint64>(data + 16);
+    m_packSize = size;
+    m_logSize = 0;
+    return true;
+}
+
+void PackedStorage::readLog() const
+{
+    QFile file(logFilePath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    // 代数不符的是整体重写之前留下的日志，内容都已在打包文件中
+    const QByteArray data = file.readAll();
+    if (data.size() < kLogHeaderSize || memcmp(data.constData(), kLogMagic, 4) != 0
+            || qFromLittleEndian<quint64>(data.constData() + 4) != m_generation) {
+        return;
+    }
+
+    qint64 pos = kLogHeaderSize;
+    while (pos + 4 <= data.size()) {
+        const qint64 length = qFromLittleEndian<quint32>(data.constData() + pos);
+        if (pos + 4 + length > data.size()) break;   // 崩溃时写了一半的末条记录
+
+        QCborParserError error;
+        const QCborArray record = QCborValue::fromCbor(data.mid(pos + 4, length), &error).toArray();
+        if (error.error != QCborError::NoError) break;
+        pos += 4 + length;
+
+        const QString rel = record.at(1).toString();
+        if (record.at(0).toInteger() == LogPut) {
+            m_entries.insert(rel, record.at(2).toByteArray());
+        } else {
+            const QString prefix = rel + '/';
+            for (auto it = m_entries.begin(); it != m_entries.end();) {
+                if (it.key() == rel || it.key().startsWith(prefix)) it = m_entries.erase(it);
+                else ++it;
+            }
+        }
+    }
+    m_logSize = pos;
+}
+
+void PackedStorage::buildTree(QList<NodeRecord>* records) const
+{
+    // 按相对路径排序，父节点总在子节点之前
+    QStringList keys = m_entries.keys();
+    std::sort(keys.begin(), keys.end());
+
+    m_children.clear();
+    QHash<QString, int> ids;
+    for (const QString& rel : std::as_const(keys)) {
+        const QString parentRel = parentOf(rel);
+        auto parent = ids.constFind(parentRel);
+        if (!rel.isEmpty() && parent == ids.constEnd()) {
+            m_entries.remove(rel);   // 父节点缺失，丢弃
+            continue;
+        }
+
+        const int id = ids.size();
+        ids.insert(rel, id);
+        if (!rel.isEmpty()) m_children[parentRel].append(rel.section('/', -1));
+
+        if (!records) continue;
+
+        NodeRecord record;
+        record.id = records->size();
+        if (rel.isEmpty()) {
+            record.name = QDir(m_rootPath).dirName();
+            record.path = m_rootPath;
+        } else {
+            record.parent = parent.value();
+            record.name = rel.section('/', -1);
+            record.path = QDir(m_rootPath).filePath(rel);
+        }
+        record.json = QCborValue::fromCbor(m_entries.value(rel)).toMap().toJsonObject();
+        records->append(record);
+    }
+
+    if (records) {
+        for (auto it = ids.cbegin(); it != ids.cend(); ++it) {
+            (*records)[it.value()].hasChildren = m_children.contains(it.key());
+        }
+    }
+}
+
+QJsonObject PackedStorage::readNode(const QString& folderPath) const
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    auto it = m_entries.constFind(relativePath(folderPath));
+    if (it == m_entries.constEnd()) return QJsonObject();
+    return QCborValue::fromCbor(it.value()).toMap().toJsonObject();
+}
+
+QStringList PackedStorage::childNames(const QString& folderPath) const
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    return m_children.value(relativePath(folderPath));
+}
+
+bool PackedStorage::writeNodes(const QHash<QString, QJsonObject>& documents)
+{
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    for (auto it = documents.cbegin(); it != documents.cend(); ++it) {
+        const QString rel = relativePath(it.key());
+        if (!rel.isEmpty() && !m_entries.contains(rel)) {
+            m_children[parentOf(rel)].append(rel.section('/', -1));
+        }
+        m_entries.insert(rel, QCborMap::fromJsonObject(it.value()).toCborValue().toCbor());
+        m_written.insert(rel);
+    }
+    m_modified = true;
+    return true;   // 只改内存，由 sync 写到磁盘
+}
+
+void PackedStorage::removeTree(const QString& folderPath)
+{
+    const QString rel = relativePath(folderPath);
+    if (rel.isEmpty()) return;
+
+    QMutexLocker locker(&m_mutex);
+    ensureLoaded();
+    const QString prefix = rel + '/';
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it.key() == rel || it.key().startsWith(prefix)) {
+            m_children.remove(it.key());
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_children[parentOf(rel)].removeAll(rel.section('/', -1));
+    m_removed.append(rel);
+    m_modified = true;
+}
+
+bool PackedStorage::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_modified) return true;
+
+    // 还没有打包文件，或追加日志已经比重写一次还贵时才整体重写
+    if (!QFile::exists(filePath()) || m_logSize > qMax(kMinCompactLog, m_packSize / 2)) return writePack();
+    return appendLog();
+}
+
+bool PackedStorage::compact()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_modified && (!m_loaded || m_logSize == 0)) return true;
+    ensureLoaded();
+    return writePack();
+}
+
+bool PackedStorage::appendLog()
+{
+    QFile file(logFilePath());
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << "无法打开文件写入:" << file.fileName();
+        return false;
+    }
+
+    // 没有有效日志时新建；否则截掉上次写了一半的尾部再追加
+    const bool fresh = m_logSize == 0;
+    QByteArray out;
+    if (fresh) {
+        char header[kLogHeaderSize];
+        memcpy(header, kLogMagic, 4);
+        qToLittleEndian<quint64>(m_generation, header + 4);
+        out.append(header, kLogHeaderSize);
+    }
+    if (!file.resize(m_logSize) || !file.seek(m_logSize)) return false;
+
+    // 先删除后写入：删掉又重建的节点以当前内容为准，已删除的节点不会写回
+    for (const QString& rel : std::as_const(m_removed)) appendRecord(out, LogRemoveTree, rel, QByteArray());
+    for (const QString& rel : std::as_const(m_written)) {
+        auto it = m_entries.constFind(rel);
+        if (it != m_entries.constEnd()) appendRecord(out, LogPut, rel, it.value());
+    }
+
+    if (file.write(out) != out.size() || !file.flush()) {
+        qWarning() << "无法写入打包日志:" << file.fileName();
+        return false;
+    }
+    if (m_durability == DurableWriter::Durable) {
+        if (!syncHandle(file.handle())) return false;
+        if (fresh && !DurableWriter::syncDirectory(m_rootPath)) return false;
+    }
+
+    m_logSize += out.size();
+    m_written.clear();
+    m_removed.clear();
+    m_modified = false;
+    return true;
+}
+
+bool PackedStorage::writePack()
+{
+    QStringList keys = m_entries.keys();
+    std::sort(keys.begin(), keys.end());
+
+    QSaveFile file(filePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法打开文件写入:" << file.fileName();
+        return false;
+    }
+
+    QCborArray index;
+    qint64 offset = kHeaderSize;
+    for (const QString& key : std::as_const(keys)) {
+        const qint64 length = m_entries.value(key).size();
+        index.append(QCborArray{ key, offset, length });
+        offset += length;
+    }
+
+    // 代数加一，重写之前的追加日志随之失效
+    const quint64 generation = m_generation + 1;
+    char header[kHeaderSize];
+    memcpy(header, kMagic, 4);
+    qToLittleEndian<quint32>(kVersion, header + 4);
+    qToLittleEndian<quint64>(quint64(offset), header + 8);
+    qToLittleEndian<quint64>(generation, header + 16);
+
+    file.write(header, kHeaderSize);
+    for (const QString& key : std::as_const(keys)) {
+        file.write(m_entries.value(key));
+    }
+    file.write(QCborValue(index).toCbor());
+
+    // QSaveFile 提交时已刷写文件内容并原子替换；持久模式下再刷目录项，让替换本身落盘
+    if (!file.commit()) {
+        qWarning() << "无法写入打包文件:" << file.fileName();
+        return false;
+    }
+    if (m_durability == DurableWriter::Durable && !DurableWriter::syncDirectory(m_rootPath)) return false;
+
+    m_generation = generation;
+    m_packSize = QFileInfo(filePath()).size();
+    m_logSize = 0;
+    QFile::remove(logFilePath());
+    m_written.clear();
+    m_removed.clear();
+    m_modified = false;
+    return true;
+}
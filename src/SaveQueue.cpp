@@ -0,0 +1,387 @@
+#include "SaveQueue.h"
+#include "MindMapNode.h"
+#include <QDebug>
+#include <utility>
+
+SaveQueue::SaveQueue(QObject* parent)
+    : QObject(parent), m_checkpoint(0), m_durability(DurableWriter::Durable)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(500);
+    connect(&m_timer, &QTimer::timeout, this, &SaveQueue::writeBehind);
+
+    m_writer.setMaxThreadCount(1);
+}
+
+SaveQueue::~SaveQueue()
+{
+    // 析构时不再访问节点（可能已被删除），只等待已提交的写入完成
+    m_timer.stop();
+    m_writer.waitForDone();
+}
+
+void SaveQueue::setStorage(const QSharedPointer<MapStorage>& storage)
+{
+    m_writer.waitForDone();
+    applyConfirmed();
+    m_detached.clear();
+    QMutexLocker locker(&m_mutex);
+    m_written.clear();
+    // 换到另一张图时，旧图写入失败的文档无处可写，只能放弃（修改仍在旧图的编辑日志中）
+    if (!storage || !m_storage || storage->rootPath() != m_storage->rootPath()) {
+        if (!m_unsynced.isEmpty()) qWarning() << "放弃写入失败的节点文档:" << m_unsynced.size();
+        m_unsynced.clear();
+        // 放弃的文档不会再确认，节点按已保存的散列比较，下次修改照常写出
+        m_inFlight.clear();
+        m_confirmed.clear();
+    }
+    locker.unlock();
+    // 打开另一张图时先清理上次崩溃留下的临时文件，排在这张图的所有写入之前
+    if (storage && (!m_storage || storage->rootPath() != m_storage->rootPath())) {
+        m_writer.start([root = storage->rootPath()]() {
+            const int removed = DurableWriter::removeStaleTemps(root);
+            if (removed > 0) qWarning() << "删除上次中断留下的临时文件:" << removed;
+        });
+    }
+    m_storage = storage;
+    if (m_storage) m_storage->setDurability(m_durability);
+}
+
+void SaveQueue::setDurability(DurableWriter::Durability durability)
+{
+    // 等后台写入结束再切换，一批之内不混用两种方式
+    m_writer.waitForDone();
+    m_durability = durability;
+    if (m_storage) m_storage->setDurability(durability);
+}
+
+void SaveQueue::setJournal(const QSharedPointer<MapJournal>& journal)
+{
+    m_writer.waitForDone();
+    m_journal = journal;
+    m_checkpoint = 0;
+}
+
+void SaveQueue::markDirty(MindMapNode* node)
+{
+    if (!node) return;
+    m_dirty.insert(node);
+
+    // 不重置已在计时的定时器，避免连续拖动时一直不落盘
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+void SaveQueue::removeTree(const QString& folderPath)
+{
+    // 子树中的节点随后删除，待写的文档不再写出，否则会写到已删除的文件夹里
+    const QString prefix = folderPath + '/';
+    const auto inTree = [&](const QString& path) { return path == folderPath || path.startsWith(prefix); };
+    for (auto it = m_dirty.begin(); it != m_dirty.end();) {
+        if (inTree((*it)->folderPath())) it = m_dirty.erase(it);
+        else ++it;
+    }
+    for (auto it = m_detached.begin(); it != m_detached.end();) {
+        if (inTree(it.key())) it = m_detached.erase(it);
+        else ++it;
+    }
+
+    // 只等已提交的写入结束，不为删除单独做一次持久提交
+    m_writer.waitForDone();
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_unsynced.begin(); it != m_unsynced.end();) {
+        if (inTree(it.key())) it = m_unsynced.erase(it);
+        else ++it;
+    }
+    locker.unlock();
+
+    if (m_storage) {
+        m_storage->removeTree(folderPath);
+        m_writer.start([storage = m_storage]() { storage->sync(); });
+    }
+}
+
+int SaveQueue::pendingCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_dirty.size() + m_detached.size() + m_unsynced.size();
+}
+
+void SaveQueue::detach(MindMapNode* node, const QJsonObject& json)
+{
+    if (!m_dirty.remove(node)) return;
+    const QString path = node->folderPath();
+    if (path.isEmpty()) return;
+
+    const quint64 hash = MapStorage::contentHash(json);
+    const quint64 last = lastHash(node);
+    m_inFlight.remove(node);   // 图形项随后换绑，不再把确认结果记到它上面
+    if (hash == last) return;
+    m_detached.insert(path, json);
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+bool SaveQueue::pendingDocument(const QString& path, QJsonObject* json) const
+{
+    auto detached = m_detached.constFind(path);
+    if (detached != m_detached.constEnd()) {
+        *json = detached.value();
+        return true;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    for (const QHash<QString, QJsonObject>* documents : { &m_submitted, &m_unsynced }) {
+        auto it = documents->constFind(path);
+        if (it != documents->constEnd()) {
+            *json = it.value();
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList SaveQueue::pendingPaths() const
+{
+    QStringList paths = m_detached.keys();
+    QMutexLocker locker(&m_mutex);
+    paths += m_submitted.keys();
+    paths += m_unsynced.keys();
+    return paths;
+}
+
+void SaveQueue::overlay(NodeRecord& record) const
+{
+    // 散列取待写文档的：写入完成后存储中就是它，之后改回存储旧内容的修改仍会写出
+    QJsonObject json;
+    if (pendingDocument(record.path, &json)) {
+        record.json = json;
+        record.hash = MapStorage::contentHash(json);
+    }
+    if (record.hasChildren) return;
+
+    const QString prefix = record.path + '/';
+    for (const QString& path : pendingPaths()) {
+        if (path.startsWith(prefix)) {
+            record.hasChildren = true;
+            return;
+        }
+    }
+}
+
+void SaveQueue::overlayChildren(const QString& folderPath, QList<NodeRecord>& records) const
+{
+    QSet<QString> names;
+    for (NodeRecord& record : records) {
+        names.insert(record.name);
+        overlay(record);
+    }
+
+    // 打包格式的子节点列表只含已写入的节点，新建的子节点要从队列中补上
+    const QString prefix = folderPath + '/';
+    for (const QString& path : pendingPaths()) {
+        if (!path.startsWith(prefix)) continue;
+        const QString name = path.mid(prefix.size());
+        if (name.contains('/') || names.contains(name)) continue;
+
+        names.insert(name);
+        NodeRecord record;
+        record.name = name;
+        record.path = path;
+        record.hasChildren = m_storage && !m_storage->childNames(path).isEmpty();
+        overlay(record);
+        records.append(record);
+    }
+}
+
+void SaveQueue::forget(MindMapNode* node)
+{
+    m_dirty.remove(node);
+    m_inFlight.remove(node);
+}
+
+quint64 SaveQueue::lastHash(MindMapNode* node) const
+{
+    auto it = m_inFlight.constFind(node);
+    return it != m_inFlight.constEnd() ? it.value() : node->savedHash();
+}
+
+void SaveQueue::applyConfirmed()
+{
+    QMutexLocker locker(&m_mutex);
+    const QHash<QString, quint64> confirmed = std::exchange(m_confirmed, {});
+    locker.unlock();
+    if (confirmed.isEmpty()) return;
+
+    // 之后又提交了新内容的节点等新内容确认；路径变了的节点等新路径上的写入确认
+    for (auto it = m_inFlight.begin(); it != m_inFlight.end();) {
+        auto done = confirmed.constFind(it.key()->folderPath());
+        if (done != confirmed.constEnd() && done.value() == it.value()) {
+            it.key()->setSavedHash(it.value());
+            it = m_inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int SaveQueue::flush()
+{
+    m_timer.stop();
+    const int written = writeBehind();
+    m_writer.waitForDone();
+    applyConfirmed();
+    return written;
+}
+
+int SaveQueue::handOff()
+{
+    const QHash<QString, QJsonObject> batch = takeBatch();
+    if (!batch.isEmpty()) submit(batch, false);
+    // 没有新文档时也要等之前提交的写入结束，读取方才能看到它们
+    m_writer.waitForDone();
+    applyConfirmed();
+
+    // 交出的文档还没刷盘，由定时器安排持久提交
+    QMutexLocker locker(&m_mutex);
+    const bool unsynced = !m_unsynced.isEmpty();
+    locker.unlock();
+    if (unsynced && !m_timer.isActive()) m_timer.start();
+    return batch.size();
+}
+
+int SaveQueue::takeWrittenCount()
+{
+    // 延迟写入随时在后台进行，保存时仍待写的往往很少，按实际落盘的节点统计
+    QMutexLocker locker(&m_mutex);
+    const int count = m_written.size();
+    m_written.clear();
+    return count;
+}
+
+void SaveQueue::setInterval(int msec)
+{
+    m_timer.setInterval(msec);
+}
+
+int SaveQueue::writeBehind()
+{
+    // 没有脏节点时，只要日志还有未合并的记录也要提交一次以便截断
+    // 有写入失败或尚未刷盘的文档时也要提交一次，让写入线程重写并刷盘
+    const bool journalPending = m_journal && m_journal->size() > m_checkpoint;
+    bool unsynced;
+    {
+        QMutexLocker locker(&m_mutex);
+        unsynced = !m_unsynced.isEmpty();
+    }
+    if (m_dirty.isEmpty() && m_detached.isEmpty() && !journalPending && !unsynced) return 0;
+
+    const QHash<QString, QJsonObject> batch = takeBatch();
+    submit(batch, true);
+    return batch.size();
+}
+
+QHash<QString, QJsonObject> SaveQueue::takeBatch()
+{
+    // 节点序列化在GUI线程完成（需要读取图形项状态），写入交给后台线程；
+    // 已换绑图形项留下的文档在前，同一路径又有脏节点时以节点为准
+    applyConfirmed();
+    QHash<QString, QJsonObject> batch;
+    batch.swap(m_detached);
+    for (MindMapNode* node : std::as_const(m_dirty)) {
+        const QString path = node->folderPath();
+        if (path.isEmpty()) continue;
+
+        // 改了又改回、展开后又折叠之类的修改不产生写入
+        const QJsonObject json = node->toJson();
+        const quint64 hash = MapStorage::contentHash(json);
+        if (hash == lastHash(node)) continue;
+        // 写入成功前不改节点上的散列，失败的文档被放弃时下次保存仍会写出
+        m_inFlight.insert(node, hash);
+        batch.insert(path, json);
+    }
+    m_dirty.clear();
+    return batch;
+}
+
+void SaveQueue::submit(const QHash<QString, QJsonObject>& batch, bool durable)
+{
+    if (!m_storage) return;
+
+    // 写完之前按需加载的节点从这里取到最新文档
+    QMutexLocker locker(&m_mutex);
+    for (auto it = batch.cbegin(); it != batch.cend(); ++it) m_submitted.insert(it.key(), it.value());
+    locker.unlock();
+
+    if (!durable) {
+        // 只交给存储，日志不截断，断电后仍由日志恢复
+        m_writer.start([this, storage = m_storage, batch]() {
+            if (!write(storage, batch, false)) retryLater();
+        });
+        return;
+    }
+
+    // 此刻之前追加的日志记录都已反映在这批文档中
+    const qint64 checkpoint = m_journal ? m_journal->size() : 0;
+    m_checkpoint = checkpoint;
+
+    m_writer.start([this, storage = m_storage, journal = m_journal, batch, checkpoint]() {
+        // 先保证日志落盘，再改写节点文件，中途断电可由日志恢复
+        if (journal) journal->sync();
+        // 没有落盘的修改只剩日志里有，写入失败时不能截断
+        if (!write(storage, batch, true)) {
+            retryLater();
+            return;
+        }
+        if (journal) journal->compact(checkpoint);
+    });
+}
+
+bool SaveQueue::write(const QSharedPointer<MapStorage>& storage, const QHash<QString, QJsonObject>& submitted,
+                      bool durable)
+{
+    // 写入按提交顺序执行，之前留下的文档都比本批旧，同一节点以本批为准。
+    // 它们与本批一起持久写入后，截断日志才不会丢掉只在日志中的修改
+    QHash<QString, QJsonObject> batch = submitted;
+    QMutexLocker locker(&m_mutex);
+    // 写完之前它们仍留在 m_unsynced 中，按需加载时可以取到；只有写入线程改动它
+    for (auto it = m_unsynced.cbegin(); it != m_unsynced.cend(); ++it) {
+        if (!batch.contains(it.key())) batch.insert(it.key(), it.value());
+    }
+    locker.unlock();
+
+    // 交出时最多做原子替换，不刷盘；写入线程只有一个，改完即恢复
+    const DurableWriter::Durability durability = storage->durability();
+    if (!durable && durability == DurableWriter::Durable) storage->setDurability(DurableWriter::Atomic);
+    const bool written = storage->writeNodes(batch) && storage->sync();
+    storage->setDurability(durability);
+
+    locker.relock();
+    // 写完或转入 m_unsynced 后不再算作在写；之后又提交了新版本的保留
+    for (auto it = submitted.cbegin(); it != submitted.cend(); ++it) {
+        auto pending = m_submitted.find(it.key());
+        if (pending != m_submitted.end() && pending.value() == it.value()) m_submitted.erase(pending);
+    }
+    if (written) {
+        for (auto it = batch.cbegin(); it != batch.cend(); ++it) {
+            m_written.insert(it.key());
+            m_confirmed.insert(it.key(), MapStorage::contentHash(it.value()));
+        }
+        if (durable) m_unsynced.clear();
+        else m_unsynced = batch;
+        locker.unlock();
+        // 回到GUI线程把确认结果记到节点上；队列析构后不再投递
+        QMetaObject::invokeMethod(this, [this]() { applyConfirmed(); }, Qt::QueuedConnection);
+        return true;
+    }
+
+    qWarning() << "节点文档写入失败，保留编辑日志并稍后重试:" << batch.size();
+    m_unsynced = batch;
+    return false;
+}
+
+void SaveQueue::retryLater()
+{
+    // 回到GUI线程安排下一次写入；队列析构后不再投递
+    QMetaObject::invokeMethod(this, [this]() {
+        if (!m_timer.isActive()) m_timer.start();
+    }, Qt::QueuedConnection);
+}
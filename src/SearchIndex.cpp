@@ -0,0 +1,248 @@
+#include "SearchIndex.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QJsonArray>
+#include <QSet>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = { 'M', 'M', 'S', 'I' };
+const quint32 kVersion = 1;
+}
+
+void SearchIndex::reset(const QString& rootPath)
+{
+    m_rootPath = rootPath;
+    m_nodes = SymbolTable();
+    m_contents.clear();
+    m_postings.clear();
+    m_live = 0;
+    m_complete = false;
+    m_modified = false;
+}
+
+bool SearchIndex::load()
+{
+    QFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    char magic[4];
+    quint32 version = 0;
+    if (in.readRawData(magic, 4) != 4 || memcmp(magic, kMagic, 4) != 0) return false;
+    in >> version;
+    if (version != kVersion) return false;
+
+    QVector<QString> paths;
+    QVector<QString> contents;
+    QHash<quint64, QVector<int>> postings;
+    in >> paths >> contents >> postings;
+    if (in.status() != QDataStream::Ok || contents.size() > paths.size()) return false;
+
+    m_nodes = SymbolTable();
+    for (const QString& path : std::as_const(paths)) m_nodes.id(path);
+    m_contents = contents;
+    m_postings = postings;
+    m_live = int(std::count_if(m_contents.cbegin(), m_contents.cend(), [](const QString& c) { return !c.isEmpty(); }));
+    m_complete = true;
+    m_modified = false;
+    return true;
+}
+
+bool SearchIndex::save()
+{
+    if (!m_modified || !m_complete || m_rootPath.isEmpty()) return true;
+
+    QVector<QString> paths;
+    paths.reserve(m_nodes.size());
+    for (int i = 0; i < m_nodes.size(); ++i) paths.append(m_nodes.name(i));
+
+    // 先写临时文件再替换，写到一半崩溃不会留下损坏的索引
+    QSaveFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.writeRawData(kMagic, 4);
+    out << kVersion << paths << m_contents << m_postings;
+    if (!file.commit()) return false;
+
+    m_modified = false;
+    return true;
+}
+
+void SearchIndex::discard()
+{
+    QFile::remove(QDir(m_rootPath).filePath(fileName()));
+    m_complete = false;
+}
+
+void SearchIndex::markModified()
+{
+    // 节点文档随时落盘而索引只在保存时写出，第一次修改时先删掉磁盘上的索引
+    if (!m_modified && m_complete) QFile::remove(QDir(m_rootPath).filePath(fileName()));
+    m_modified = true;
+}
+
+void SearchIndex::rebuild(const QList<NodeRecord>& records)
+{
+    reset(m_rootPath);
+    m_contents.reserve(records.size());
+    for (const NodeRecord& record : records) addRecord(record);
+    m_complete = true;
+    m_modified = true;
+}
+
+QString SearchIndex::relativePath(const QString& folderPath) const
+{
+    QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    if (rel == ".") rel.clear();
+    return rel;
+}
+
+QString SearchIndex::absolutePath(const QString& rel) const
+{
+    return rel.isEmpty() ? m_rootPath : QDir(m_rootPath).filePath(rel);
+}
+
+quint64 SearchIndex::trigramKey(const QChar* chars)
+{
+    return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | chars[2].unicode();
+}
+
+QString SearchIndex::content(const QString& text, const QStringList& tags)
+{
+    // 换行分隔各段，查询串不含换行，不会跨段匹配
+    QString result = text.toLower();
+    for (const QString& tag : tags) {
+        result += '\n';
+        result += tag.toLower();
+    }
+    return result;
+}
+
+void SearchIndex::addRecord(const NodeRecord& record)
+{
+    const QJsonObject& json = record.json;
+    QStringList tags;
+    for (const QJsonValue& tag : json["tags"].toArray()) tags.append(tag.toString());
+    update(record.path, json.contains("text") ? json["text"].toString() : record.name, tags);
+}
+
+void SearchIndex::update(const QString& folderPath, const QString& text, const QStringList& tags)
+{
+    const int id = m_nodes.id(relativePath(folderPath));
+    if (id >= m_contents.size()) m_contents.resize(id + 1);
+
+    const QString next = content(text, tags);
+    if (!m_contents[id].isEmpty()) {
+        if (m_contents[id] == next) return;
+        erase(id);
+    }
+    insert(id, next);
+}
+
+void SearchIndex::insert(int id, const QString& content)
+{
+    if (content.isEmpty()) return;
+    m_contents[id] = content;
+    ++m_live;
+    markModified();
+
+    // 同一节点内重复的三元组只登记一次
+    QVarLengthArray<quint64, 64> keys;
+    for (qsizetype i = 0; i + 3 <= content.size(); ++i) keys.append(trigramKey(content.constData() + i));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (quint64 key : keys) {
+        // 新节点编号最大，通常直接追加到数组末尾
+        QVector<int>& ids = m_postings[key];
+        if (ids.isEmpty() || ids.last() < id) {
+            ids.append(id);
+        } else {
+            auto it = std::lower_bound(ids.begin(), ids.end(), id);
+            if (it == ids.end() || *it != id) ids.insert(it, id);
+        }
+    }
+}
+
+void SearchIndex::erase(int id)
+{
+    const QString content = m_contents[id];
+    for (qsizetype i = 0; i + 3 <= content.size(); ++i) {
+        auto posting = m_postings.find(trigramKey(content.constData() + i));
+        if (posting == m_postings.end()) continue;
+        QVector<int>& ids = posting.value();
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) ids.erase(it);
+        if (ids.isEmpty()) m_postings.erase(posting);
+    }
+    m_contents[id].clear();
+    --m_live;
+    markModified();
+}
+
+void SearchIndex::removeTree(const QString& folderPath)
+{
+    const QString rel = relativePath(folderPath);
+    const QString prefix = rel + '/';
+    for (int id = 0; id < m_contents.size(); ++id) {
+        if (m_contents[id].isEmpty()) continue;
+        const QString path = m_nodes.name(id);
+        if (path == rel || path.startsWith(prefix)) erase(id);
+    }
+}
+
+QStringList SearchIndex::search(const QString& query, int limit) const
+{
+    const QString needle = query.trimmed().toLower();
+    QStringList paths;
+    if (needle.isEmpty() || limit <= 0) return paths;
+
+    auto accept = [&](int id) {
+        if (m_contents[id].contains(needle)) paths.append(absolutePath(m_nodes.name(id)));
+        return paths.size() < limit;
+    };
+
+    if (needle.size() < 3) {
+        // 短查询匹配的节点很多，顺序扫描很快就能取够
+        for (int id = 0; id < m_contents.size(); ++id) {
+            if (!m_contents[id].isEmpty() && !accept(id)) break;
+        }
+        return paths;
+    }
+
+    QVector<const QVector<int>*> lists;
+    QSet<quint64> seen;
+    for (qsizetype i = 0; i + 3 <= needle.size(); ++i) {
+        const quint64 key = trigramKey(needle.constData() + i);
+        if (seen.contains(key)) continue;
+        seen.insert(key);
+        auto it = m_postings.constFind(key);
+        if (it == m_postings.constEnd()) return paths;   // 有三元组不存在，必然无结果
+        lists.append(&it.value());
+    }
+
+    // 从最短的数组开始求交
+    std::sort(lists.begin(), lists.end(), [](const QVector<int>* a, const QVector<int>* b) {
+        return a->size() < b->size();
+    });
+    QVector<int> candidates = *lists.first();
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        QVector<int> next;
+        std::set_intersection(candidates.cbegin(), candidates.cend(),
+                              lists[i]->cbegin(), lists[i]->cend(), std::back_inserter(next));
+        candidates.swap(next);
+    }
+
+    // 三元组都出现不代表连续出现，逐个核对
+    for (int id : std::as_const(candidates)) {
+        if (!accept(id)) break;
+    }
+    return paths;
+}
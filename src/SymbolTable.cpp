@@ -0,0 +1,38 @@
+#include "SymbolTable.h"
+
+int SymbolTable::id(const QString& name)
+{
+    auto it = m_ids.constFind(name);
+    if (it != m_ids.constEnd()) return it.value();
+
+    const int id = m_names.size();
+    m_names.append(name);
+    m_ids.insert(m_names.last(), id);   // 键与名字表共享同一份数据
+    return id;
+}
+
+int SymbolTable::find(const QString& name) const
+{
+    return m_ids.value(name, -1);
+}
+
+qint64 SymbolTable::bytes() const
+{
+    // 字符串头约 16 字节，哈希表每项按键值加一个指针估算
+    qint64 total = qint64(m_names.capacity()) * qint64(sizeof(QString));
+    for (const QString& name : m_names) total += 16 + (name.size() + 1) * 2;
+    total += qint64(m_ids.size()) * qint64(sizeof(QString) + sizeof(int) + sizeof(void*));
+    return total;
+}
+
+SymbolTable& SymbolTable::tags()
+{
+    static SymbolTable table;
+    return table;
+}
+
+SymbolTable& SymbolTable::segments()
+{
+    static SymbolTable table;
+    return table;
+}
@@ -0,0 +1,202 @@
+#include "TagIndex.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QJsonArray>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = { 'M', 'M', 'T', 'I' };
+const quint32 kVersion = 1;
+
+void insertSorted(QVector<int>& ids, int id)
+{
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id) ids.insert(it, id);
+}
+}
+
+void TagIndex::reset(const QString& rootPath)
+{
+    m_rootPath = rootPath;
+    m_nodes = SymbolTable();
+    m_postings.clear();
+    m_complete = false;
+    m_modified = false;
+}
+
+QString TagIndex::relativePath(const QString& folderPath) const
+{
+    QString rel = QDir(m_rootPath).relativeFilePath(folderPath);
+    if (rel == ".") rel.clear();
+    return rel;
+}
+
+QString TagIndex::absolutePath(const QString& rel) const
+{
+    return rel.isEmpty() ? m_rootPath : QDir(m_rootPath).filePath(rel);
+}
+
+bool TagIndex::load()
+{
+    QFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    char magic[4];
+    quint32 version = 0;
+    if (in.readRawData(magic, 4) != 4 || memcmp(magic, kMagic, 4) != 0) return false;
+    in >> version;
+    if (version != kVersion) return false;
+
+    QVector<QString> paths;
+    QHash<QString, QVector<int>> postings;
+    in >> paths >> postings;
+    if (in.status() != QDataStream::Ok) return false;
+
+    m_nodes = SymbolTable();
+    for (const QString& path : std::as_const(paths)) m_nodes.id(path);
+    m_postings = postings;
+    m_complete = true;
+    m_modified = false;
+    return true;
+}
+
+bool TagIndex::save()
+{
+    if (!m_modified || !m_complete || m_rootPath.isEmpty()) return true;
+
+    QVector<QString> paths;
+    paths.reserve(m_nodes.size());
+    for (int i = 0; i < m_nodes.size(); ++i) paths.append(m_nodes.name(i));
+
+    // 先写临时文件再替换，写到一半崩溃不会留下损坏的索引
+    QSaveFile file(QDir(m_rootPath).filePath(fileName()));
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.writeRawData(kMagic, 4);
+    out << kVersion << paths << m_postings;
+    if (!file.commit()) return false;
+
+    m_modified = false;
+    return true;
+}
+
+void TagIndex::discard()
+{
+    QFile::remove(QDir(m_rootPath).filePath(fileName()));
+    m_complete = false;
+}
+
+void TagIndex::markModified()
+{
+    // 节点文档由延迟写入队列随时落盘，索引文件只在保存时写出。第一次修改时
+    // 先删掉磁盘上的索引：此后崩溃，下次打开找不到索引就会重建，而不是读入过期的结果
+    if (!m_modified && m_complete) QFile::remove(QDir(m_rootPath).filePath(fileName()));
+    m_modified = true;
+}
+
+void TagIndex::rebuild(const QList<NodeRecord>& records)
+{
+    reset(m_rootPath);
+    for (const NodeRecord& record : records) {
+        QStringList tags;
+        for (const QJsonValue& tag : record.json["tags"].toArray()) tags.append(tag.toString());
+        addNode(record.path, tags);
+    }
+    m_complete = true;
+    m_modified = true;
+}
+
+void TagIndex::addNode(const QString& folderPath, const QStringList& tags)
+{
+    if (tags.isEmpty()) return;
+    const int id = m_nodes.id(relativePath(folderPath));
+    for (const QString& tag : tags) insertSorted(m_postings[tag], id);
+    markModified();
+}
+
+void TagIndex::add(const QString& folderPath, const QString& tag)
+{
+    insertSorted(m_postings[tag], m_nodes.id(relativePath(folderPath)));
+    markModified();
+}
+
+void TagIndex::remove(const QString& folderPath, const QString& tag)
+{
+    auto posting = m_postings.find(tag);
+    const int id = m_nodes.find(relativePath(folderPath));
+    if (posting == m_postings.end() || id < 0) return;
+
+    QVector<int>& ids = posting.value();
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id) return;
+    ids.erase(it);
+    if (ids.isEmpty()) m_postings.erase(posting);
+    markModified();
+}
+
+void TagIndex::removeTree(const QString& folderPath)
+{
+    // 子树中的节点编号不连续，逐个标签过滤；删除节点远少于打标签
+    const QString rel = relativePath(folderPath);
+    const QString prefix = rel + '/';
+    for (auto posting = m_postings.begin(); posting != m_postings.end();) {
+        QVector<int>& ids = posting.value();
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [&](int id) {
+            const QString path = m_nodes.name(id);
+            return path == rel || path.startsWith(prefix);
+        }), ids.end());
+        if (ids.isEmpty()) {
+            posting = m_postings.erase(posting);
+        } else {
+            ++posting;
+        }
+    }
+    markModified();
+}
+
+QStringList TagIndex::query(const QStringList& tags, Match match) const
+{
+    QVector<const QVector<int>*> lists;
+    for (const QString& tag : tags) {
+        auto it = m_postings.constFind(tag);
+        if (it != m_postings.constEnd()) {
+            lists.append(&it.value());
+        } else if (match == MatchAll) {
+            return QStringList();   // 有一个标签没有节点，交集为空
+        }
+    }
+    if (lists.isEmpty()) return QStringList();
+
+    QVector<int> result;
+    if (match == MatchAll) {
+        // 从最短的数组开始求交，中间结果只会越来越短
+        std::sort(lists.begin(), lists.end(), [](const QVector<int>* a, const QVector<int>* b) {
+            return a->size() < b->size();
+        });
+        result = *lists.first();
+        for (int i = 1; i < lists.size() && !result.isEmpty(); ++i) {
+            QVector<int> next;
+            std::set_intersection(result.cbegin(), result.cend(),
+                                  lists[i]->cbegin(), lists[i]->cend(), std::back_inserter(next));
+            result.swap(next);
+        }
+    } else {
+        for (const QVector<int>* ids : std::as_const(lists)) {
+            QVector<int> next;
+            next.reserve(result.size() + ids->size());
+            std::set_union(result.cbegin(), result.cend(), ids->cbegin(), ids->cend(), std::back_inserter(next));
+            result.swap(next);
+        }
+    }
+
+    QStringList paths;
+    paths.reserve(result.size());
+    for (int id : std::as_const(result)) paths.append(absolutePath(m_nodes.name(id)));
+    return paths;
+}
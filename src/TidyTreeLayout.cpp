@@ -0,0 +1,206 @@
+#include "TidyTreeLayout.h"
+#include <QtGlobal>
+
+namespace {
+const qreal kSiblingGap = 16;   // 同一父节点下相邻子树的间距
+const qreal kSubtreeGap = 32;   // 不同父节点的相邻子树间距
+const qreal kLevelGap = 60;     // 层与层之间的间距
+}
+
+TidyTreeLayout::TidyTreeLayout(LayoutSnapshot& snapshot)
+    : m_flat(snapshot)
+{
+}
+
+void TidyTreeLayout::run(bool balanced)
+{
+    const int count = m_flat.size();
+    if (count == 0) return;
+
+    m_lastChild.fill(-1, count);
+    m_number.fill(0, count);
+    m_thread.fill(-1, count);
+    m_ancestor.resize(count);
+    m_prelim.fill(0, count);
+    m_mod.fill(0, count);
+    m_shift.fill(0, count);
+    m_change.fill(0, count);
+    m_offset.fill(0, count);
+    for (int i = 0; i < count; ++i) {
+        m_ancestor[i] = i;
+        for (int c = m_flat.firstChild[i]; c >= 0; c = m_flat.nextSibling[c]) m_lastChild[i] = c;
+    }
+
+    // 1. 子项下标总大于父项，逆序处理即为自底向上；根的子节点单独按侧处理
+    QVector<int> kids;
+    for (int i = count - 1; i > 0; --i) {
+        if (m_flat.firstChild[i] < 0) continue;
+        kids.clear();
+        for (int c = m_flat.firstChild[i]; c >= 0; c = m_flat.nextSibling[c]) kids.append(c);
+        layoutChildren(i, kids);
+    }
+
+    // 根的子树按节点数大致均分到右侧和左侧，保持原有顺序
+    QVector<int> right, left;
+    QVector<bool> mirrored(count, false);
+    int total = 0;
+    for (int c = m_flat.firstChild[0]; c >= 0; c = m_flat.nextSibling[c]) total += m_flat.rows[c];
+    int placed = 0;
+    for (int c = m_flat.firstChild[0]; c >= 0; c = m_flat.nextSibling[c]) {
+        if (balanced && placed * 2 >= total) {
+            left.append(c);
+            mirrored[c] = true;
+        } else {
+            right.append(c);
+        }
+        placed += m_flat.rows[c];
+    }
+    for (const QVector<int>* side : { &right, &left }) {
+        if (side->isEmpty()) continue;
+        layoutChildren(0, *side);
+        for (int c : *side) m_offset[c] = -m_prelim[0]; // 每侧以根为中心
+    }
+
+    // 2. 自顶向下累加祖先的 mod，得到纵向坐标；同时记录深度
+    QVector<qreal> y(count, 0);
+    QVector<qreal> sum(count, 0);   // 祖先 mod 之和
+    QVector<int> depth(count, 0);
+    QVector<qreal> levelWidth;
+    levelWidth.append(m_flat.width[0]);
+    for (int i = 1; i < count; ++i) {
+        const int p = m_flat.parent[i];
+        sum[i] = p == 0 ? m_offset[i] : sum[p] + m_mod[p];
+        y[i] = m_prelim[i] + sum[i];
+        depth[i] = depth[p] + 1;
+        if (p != 0) mirrored[i] = mirrored[p];
+
+        if (depth[i] >= levelWidth.size()) levelWidth.append(0);
+        levelWidth[depth[i]] = qMax(levelWidth[depth[i]], qreal(m_flat.width[i]));
+    }
+
+    // 3. 横向按层排开，每层宽度取该层最宽的节点
+    QVector<qreal> levelX(levelWidth.size(), 0);
+    for (int d = 1; d < levelWidth.size(); ++d) {
+        levelX[d] = levelX[d - 1] + levelWidth[d - 1] / 2 + kLevelGap + levelWidth[d] / 2;
+    }
+
+    // 快照中的位置相对父节点
+    m_flat.pos.resize(count);
+    m_flat.pos[0] = QPointF(0, 0);
+    for (int i = 1; i < count; ++i) {
+        const int p = m_flat.parent[i];
+        const qreal dx = levelX[depth[i]] - levelX[depth[p]];
+        m_flat.pos[i] = QPointF(mirrored[i] ? -dx : dx, y[i] - y[p]);
+    }
+}
+
+void TidyTreeLayout::layoutChildren(int v, const QVector<int>& kids)
+{
+    int defaultAncestor = kids.first();
+    for (int k = 0; k < kids.size(); ++k) {
+        const int w = kids[k];
+        m_number[w] = k;
+
+        // 先紧贴左侧兄弟放置；叶子的 mod 保持为零
+        if (k > 0) {
+            const int s = kids[k - 1];
+            const qreal delta = m_prelim[s] + distance(s, w) - m_prelim[w];
+            m_prelim[w] += delta;
+            if (m_flat.firstChild[w] >= 0) m_mod[w] += delta;
+        }
+        defaultAncestor = apportion(w, k, kids, defaultAncestor);
+    }
+    executeShifts(kids);
+
+    // 父节点对齐到首尾子节点的中点；相对兄弟的平移由上一层处理
+    m_prelim[v] = (m_prelim[kids.first()] + m_prelim[kids.last()]) / 2;
+    m_mod[v] = 0;
+}
+
+int TidyTreeLayout::apportion(int v, int k, const QVector<int>& kids, int defaultAncestor)
+{
+    if (k == 0) return defaultAncestor;
+
+    // 沿左侧子树的右轮廓和当前子树的左轮廓逐层下行，发现重叠就右移
+    int vir = v;
+    int vor = v;
+    int vil = kids[k - 1];
+    int vol = kids.first();
+    qreal sir = m_mod[vir];
+    qreal sor = m_mod[vor];
+    qreal sil = m_mod[vil];
+    qreal sol = m_mod[vol];
+
+    while (nextRight(vil) >= 0 && nextLeft(vir) >= 0) {
+        vil = nextRight(vil);
+        vir = nextLeft(vir);
+        vol = nextLeft(vol);
+        vor = nextRight(vor);
+        m_ancestor[vor] = v;
+
+        const qreal shift = (m_prelim[vil] + sil) - (m_prelim[vir] + sir) + distance(vil, vir);
+        if (shift > 0) {
+            const int a = m_flat.parent[m_ancestor[vil]] == m_flat.parent[v] ? m_ancestor[vil] : defaultAncestor;
+            moveSubtree(a, v, shift);
+            sir += shift;
+            sor += shift;
+        }
+        sil += m_mod[vil];
+        sir += m_mod[vir];
+        sol += m_mod[vol];
+        sor += m_mod[vor];
+    }
+
+    // 较短一侧的轮廓用线索接到较长一侧
+    if (nextRight(vil) >= 0 && nextRight(vor) < 0) {
+        m_thread[vor] = nextRight(vil);
+        m_mod[vor] += sil - sor;
+    }
+    if (nextLeft(vir) >= 0 && nextLeft(vol) < 0) {
+        m_thread[vol] = nextLeft(vir);
+        m_mod[vol] += sir - sol;
+        defaultAncestor = v;
+    }
+    return defaultAncestor;
+}
+
+void TidyTreeLayout::moveSubtree(int wl, int wr, qreal shift)
+{
+    // 中间的兄弟子树按比例分摊，留到 executeShifts 一次完成
+    const int subtrees = m_number[wr] - m_number[wl];
+    if (subtrees <= 0) return;
+    m_change[wr] -= shift / subtrees;
+    m_shift[wr] += shift;
+    m_change[wl] += shift / subtrees;
+    m_prelim[wr] += shift;
+    m_mod[wr] += shift;
+}
+
+void TidyTreeLayout::executeShifts(const QVector<int>& kids)
+{
+    qreal shift = 0;
+    qreal change = 0;
+    for (int k = kids.size() - 1; k >= 0; --k) {
+        const int w = kids[k];
+        m_prelim[w] += shift;
+        m_mod[w] += shift;
+        change += m_change[w];
+        shift += m_shift[w] + change;
+    }
+}
+
+int TidyTreeLayout::nextLeft(int v) const
+{
+    return m_flat.firstChild[v] >= 0 ? m_flat.firstChild[v] : m_thread[v];
+}
+
+int TidyTreeLayout::nextRight(int v) const
+{
+    return m_lastChild[v] >= 0 ? m_lastChild[v] : m_thread[v];
+}
+
+qreal TidyTreeLayout::distance(int a, int b) const
+{
+    const qreal gap = m_flat.parent[a] == m_flat.parent[b] ? kSiblingGap : kSubtreeGap;
+    return (m_flat.height[a] + m_flat.height[b]) / 2 + gap;
+}
@@ -0,0 +1,115 @@
+#include "ViewportVirtualizer.h"
+#include "MindMapScene.h"
+#include "MindMapNode.h"
+#include "MapModel.h"
+#include "SaveQueue.h"
+#include "ItemPool.h"
+#include <QScrollBar>
+#include <QSet>
+
+namespace {
+const qreal kViewportMargin = 0.5; // 视口四周各外扩半屏
+}
+
+ViewportVirtualizer::ViewportVirtualizer(MindMapScene* scene, MapModel* model, QObject* parent)
+    : QObject(parent), m_scene(scene), m_model(model)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(16); // 约一帧
+    connect(&m_timer, &QTimer::timeout, this, &ViewportVirtualizer::refresh);
+}
+
+void ViewportVirtualizer::attach(QGraphicsView* view)
+{
+    if (m_view == view) return;
+    if (m_view) {
+        m_view->horizontalScrollBar()->disconnect(this);
+        m_view->verticalScrollBar()->disconnect(this);
+    }
+    m_view = view;
+    if (!view) return;
+
+    // 滚动和缩放都会改变滚动条的值或范围
+    for (QScrollBar* bar : { view->horizontalScrollBar(), view->verticalScrollBar() }) {
+        connect(bar, &QScrollBar::valueChanged, this, &ViewportVirtualizer::scheduleRefresh);
+        connect(bar, &QScrollBar::rangeChanged, this, &ViewportVirtualizer::scheduleRefresh);
+    }
+}
+
+void ViewportVirtualizer::scheduleRefresh()
+{
+    if (!m_timer.isActive()) m_timer.start();
+}
+
+QRectF ViewportVirtualizer::visibleRect() const
+{
+    if (!m_view) return QRectF();
+    const QRectF rect = m_view->mapToScene(m_view->viewport()->rect()).boundingRect();
+    const qreal dx = rect.width() * kViewportMargin;
+    const qreal dy = rect.height() * kViewportMargin;
+    return rect.adjusted(-dx, -dy, dx, dy);
+}
+
+void ViewportVirtualizer::refresh()
+{
+    m_timer.stop();
+    if (!m_view || m_model->size() == 0) return;
+
+    MindMapScene::BulkUpdate bulk(m_scene);
+
+    const QVector<int> wanted = m_model->query(visibleRect());
+    QSet<int> keep;
+    keep.reserve(wanted.size());
+    for (int index : wanted) keep.insert(index);
+
+    // 先回收移出视口或已被折叠隐藏的图形项，再为新进入的节点取用
+    for (auto it = m_live.begin(); it != m_live.end();) {
+        if (!keep.contains(it.key())) {
+            release(it.value());
+            it = m_live.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (int index : wanted) {
+        MindMapNode* node = m_live.value(index);
+        if (!node) {
+            node = acquire(index);
+            m_live.insert(index, node);
+        }
+        // 布局变化后已存在的图形项也要移到新位置
+        if (node->pos() != m_model->position(index)) node->setPos(m_model->position(index));
+    }
+}
+
+void ViewportVirtualizer::reset()
+{
+    m_timer.stop();
+    m_live.clear();
+}
+
+MindMapNode* ViewportVirtualizer::acquire(int index)
+{
+    // 文档由模型生成，滚动时不在GUI线程读存储；展开状态等只改模型的操作也随之生效
+    const NodeRecord record = m_model->record(index);
+
+    // 图形项从场景的回收池取用，没有父项，需自行加入场景
+    MindMapNode* node = m_scene->itemPool()->takeNode(record, nullptr);
+    m_scene->addItem(node);
+    node->setModelIndex(index);
+    node->setFlag(QGraphicsItem::ItemIsMovable, false); // 位置由模型布局决定
+    return node;
+}
+
+void ViewportVirtualizer::release(MindMapNode* node)
+{
+    // 图形项上的修改记回模型，再次进入视口时由模型生成；尚未落盘的文档
+    // 留在延迟写入队列中随下一批写出，不在这里同步刷盘
+    const QJsonObject json = node->toJson();
+    if (node->modelIndex() >= 0) m_model->store(node->modelIndex(), json);
+    SaveQueue* queue = m_scene->saveQueue();
+    if (queue->isPending(node)) queue->detach(node, json);
+
+    m_scene->itemPool()->recycle(node);
+}
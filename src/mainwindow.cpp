@@ -3,15 +3,24 @@
 #include <QGraphicsView>
 #include <QToolBar>
 #include <QAction>
+#include <QActionGroup>
 #include <QStatusBar>
 #include <QKeyEvent>
 #include <QMessageBox>
 #include <QInputDialog>
+#include <QRegularExpression>
 #include <QFileDialog>
 #include <QApplication>
+#include <QCloseEvent>
+#include <QProgressDialog>
+#include <QLineEdit>
+
+namespace {
+const int kSearchLimit = 500; // 搜索结果上限，够用户逐个查看
+}
 
 MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent), m_searchEdit(nullptr), m_searchPos(-1)
 {
     // 创建场景和视图
     m_scene = new MindMapScene(this);
@@ -22,6 +31,7 @@ MainWindow::MainWindow(QWidget* parent)
     createActions();
     createToolBar();
     createStatusBar();
+    connectSceneSignals();
 
     // 设置窗口属性
     setWindowTitle("树状结构思维导图 - 带JSON存储");
@@ -31,6 +41,13 @@ MainWindow::MainWindow(QWidget* parent)
     QMessageBox::information(this, "欢迎", "请新建或打开一个思维导图文件开始");
 }
 
+void MainWindow::closeEvent(QCloseEvent* event)
+{
+    // 关闭前写出延迟队列中的修改
+    m_scene->flushPending();
+    QMainWindow::closeEvent(event);
+}
+
 void MainWindow::createActions()
 {
     m_newAction = new QAction("新建", this);
@@ -47,29 +64,74 @@ void MainWindow::createActions()
     connect(m_openAction, &QAction::triggered, this, [this]() {
         QString path = QFileDialog::getExistingDirectory(this, "选择思维导图根文件夹");
         if (!path.isEmpty()) {
-            if (m_scene->openMap(path)) {
-                statusBar()->showMessage("已打开思维导图: " + path, 3000);
-            }
+            m_scene->openMap(path);
         }
     });
 
     m_saveAction = new QAction("保存", this);
     connect(m_saveAction, &QAction::triggered, this, [this]() {
-        if (m_scene->saveMap()) {
-            statusBar()->showMessage("思维导图已保存", 3000);
+        const int written = m_scene->saveMap();
+        if (written >= 0) {
+            statusBar()->showMessage(QString("思维导图已保存，写入 %1 个节点").arg(written), 3000);
         }
     });
 
+    m_packedAction = new QAction("单文件存储", this);
+    m_packedAction->setCheckable(true);
+    connect(m_packedAction, &QAction::toggled, this, [this](bool checked) {
+        m_scene->setStorageFormat(checked ? MapStorage::PackedFormat : MapStorage::FolderFormat);
+        statusBar()->showMessage(checked ? "下次保存时使用单文件格式" : "下次保存时使用文件夹格式", 3000);
+    });
+
+    // 关闭后仍是原子替换，文件不会写坏，但断电可能丢失最近一批修改
+    m_durableAction = new QAction("断电保护", this);
+    m_durableAction->setCheckable(true);
+    m_durableAction->setChecked(m_scene->durability() == DurableWriter::Durable);
+    connect(m_durableAction, &QAction::toggled, this, [this](bool checked) {
+        m_scene->setDurability(checked ? DurableWriter::Durable : DurableWriter::Atomic);
+    });
+
+    // 空格分隔表示同时具有全部标签，“|”分隔表示具有任一标签；留空清除筛选
+    m_tagFilterAction = new QAction("标签筛选", this);
+    connect(m_tagFilterAction, &QAction::triggered, this, [this]() {
+        bool ok;
+        const QString text = QInputDialog::getText(this, "标签筛选", "标签（空格为“且”，| 为“或”）:",
+                                                   QLineEdit::Normal, QString(), &ok);
+        if (!ok) return;
+
+        const bool any = text.contains('|');
+        const QStringList tags = text.split(any ? QRegularExpression("\\s*\\|\\s*") : QRegularExpression("\\s+"),
+                                            Qt::SkipEmptyParts);
+        const int count = m_scene->highlightByTags(tags, any ? TagIndex::MatchAny : TagIndex::MatchAll, true);
+        if (tags.isEmpty()) return;
+        if (m_scene->isIndexing()) statusBar()->showMessage("正在建立标签索引，建好后自动筛选");
+        else statusBar()->showMessage(QString("匹配 %1 个节点").arg(count), 5000);
+    });
+
+    m_memoryAction = new QAction("内存报告", this);
+    connect(m_memoryAction, &QAction::triggered, this, [this]() {
+        QMessageBox::information(this, "内存报告", m_scene->memoryReport());
+    });
+
     m_deleteAction = new QAction("删除节点", this);
     connect(m_deleteAction, &QAction::triggered, this, [this]() {
+        // 祖先也被选中的节点会随祖先一起删除，先剔除避免悬空指针
+        QList<MindMapNode*> nodes;
         for (QGraphicsItem* item : m_scene->selectedItems()) {
-            if (item->type() == MindMapNode::Type) {
-                MindMapNode* node = static_cast<MindMapNode*>(item);
-                if (!node->isRoot()) {
-                    m_scene->removeNode(node);
-                    m_scene->updateLayout();
-                }
+            if (item->type() != MindMapNode::Type) continue;
+            MindMapNode* node = static_cast<MindMapNode*>(item);
+            if (node->isRoot()) continue;
+
+            bool covered = false;
+            for (MindMapNode* p = node->parentNode(); p && !covered; p = p->parentNode()) {
+                covered = p->isSelected();
             }
+            if (!covered) nodes.append(node);
+        }
+
+        // 布局由场景按受影响的子树增量更新
+        for (MindMapNode* node : std::as_const(nodes)) {
+            m_scene->removeNode(node);
         }
     });
 
@@ -85,18 +147,38 @@ void MainWindow::createActions()
 
     m_expandAllAction = new QAction("全部展开", this);
     connect(m_expandAllAction, &QAction::triggered, this, [this]() {
-        if (m_scene->rootNode()) {
-            m_scene->recursiveSetExpanded(m_scene->rootNode(), true);
-            m_scene->updateLayout();
-        }
+        m_scene->setAllExpanded(true);
     });
 
     m_collapseAllAction = new QAction("全部折叠", this);
     connect(m_collapseAllAction, &QAction::triggered, this, [this]() {
-        if (m_scene->rootNode()) {
-            m_scene->recursiveSetExpanded(m_scene->rootNode(), false);
-            m_scene->updateLayout();
-        }
+        m_scene->setAllExpanded(false);
+    });
+
+    // 布局方式，三选一
+    QActionGroup* layoutGroup = new QActionGroup(this);
+    m_outlineLayoutAction = layoutGroup->addAction("大纲布局");
+    m_tidyLayoutAction = layoutGroup->addAction("紧凑布局");
+    m_balancedLayoutAction = layoutGroup->addAction("左右布局");
+    for (QAction* action : layoutGroup->actions()) {
+        action->setCheckable(true);
+    }
+    m_outlineLayoutAction->setChecked(true);
+
+    m_edgeLayerAction = new QAction("合并绘制连线", this);
+    m_edgeLayerAction->setCheckable(true);
+    m_edgeLayerAction->setChecked(m_scene->edgeLayerEnabled());
+    connect(m_edgeLayerAction, &QAction::toggled, m_scene, &MindMapScene::setEdgeLayerEnabled);
+
+    // 超大图只为视口附近的节点创建图形项，下次打开时生效
+    m_virtualAction = new QAction("虚拟化显示", this);
+    m_virtualAction->setCheckable(true);
+    m_virtualAction->setChecked(m_scene->isVirtualized());
+    connect(m_virtualAction, &QAction::toggled, m_scene, &MindMapScene::setVirtualized);
+    connect(layoutGroup, &QActionGroup::triggered, this, [this](QAction* action) {
+        if (action == m_tidyLayoutAction) m_scene->setLayoutMode(TidyLayout);
+        else if (action == m_balancedLayoutAction) m_scene->setLayoutMode(BalancedLayout);
+        else m_scene->setLayoutMode(OutlineLayout);
     });
 }
 
@@ -106,14 +188,87 @@ void MainWindow::createToolBar()
     toolBar->addAction(m_newAction);
     toolBar->addAction(m_openAction);
     toolBar->addAction(m_saveAction);
+    toolBar->addAction(m_packedAction);
+    toolBar->addAction(m_durableAction);
     toolBar->addSeparator();
     toolBar->addAction(m_deleteAction);
     toolBar->addSeparator();
     toolBar->addAction(m_expandAllAction);
     toolBar->addAction(m_collapseAllAction);
     toolBar->addSeparator();
+    toolBar->addAction(m_outlineLayoutAction);
+    toolBar->addAction(m_tidyLayoutAction);
+    toolBar->addAction(m_balancedLayoutAction);
+    toolBar->addAction(m_edgeLayerAction);
+    toolBar->addAction(m_virtualAction);
+    toolBar->addSeparator();
     toolBar->addAction(m_zoomInAction);
     toolBar->addAction(m_zoomOutAction);
+    toolBar->addSeparator();
+    toolBar->addAction(m_tagFilterAction);
+    toolBar->addAction(m_memoryAction);
+    toolBar->addSeparator();
+
+    // 边输入边搜索，回车跳到下一个结果
+    m_searchEdit = new QLineEdit(toolBar);
+    m_searchEdit->setPlaceholderText("搜索节点");
+    m_searchEdit->setClearButtonEnabled(true);
+    m_searchEdit->setMaximumWidth(200);
+    toolBar->addWidget(m_searchEdit);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &MainWindow::updateSearch);
+    connect(m_searchEdit, &QLineEdit::returnPressed, this, [this]() {
+        if (m_searchHits.isEmpty()) return;
+        m_searchPos = (m_searchPos + 1) % m_searchHits.size();
+        if (m_scene->revealNode(m_searchHits.at(m_searchPos))) {
+            statusBar()->showMessage(QString("第 %1/%2 个结果").arg(m_searchPos + 1).arg(m_searchHits.size()));
+        }
+    });
+}
+
+void MainWindow::updateSearch()
+{
+    const QString text = m_searchEdit->text().trimmed();
+    m_searchHits = m_scene->search(text, kSearchLimit);
+    m_searchPos = -1;
+    if (text.isEmpty()) statusBar()->clearMessage();
+    else if (m_scene->isIndexing()) statusBar()->showMessage("正在建立搜索索引…");
+    else statusBar()->showMessage(QString("找到 %1 个节点%2").arg(m_searchHits.size())
+                                  .arg(m_searchHits.size() >= kSearchLimit ? "（只列出前面部分）" : ""));
+}
+
+void MainWindow::connectSceneSignals()
+{
+    // 后台索引建好后重新执行建立期间输入的搜索
+    connect(m_scene, &MindMapScene::indexesReady, this, [this]() {
+        if (!m_searchEdit->text().trimmed().isEmpty()) updateSearch();
+    });
+
+    // 异步打开：显示进度并允许取消，窗口保持响应
+    connect(m_scene, &MindMapScene::openStarted, this, [this](const QString& path) {
+        if (m_openProgress) m_openProgress->deleteLater();
+        m_openProgress = new QProgressDialog("正在打开: " + path, "取消", 0, 0, this);
+        m_openProgress->setWindowModality(Qt::WindowModal);
+        m_openProgress->setMinimumDuration(300);
+        connect(m_openProgress, &QProgressDialog::canceled, m_scene, &MindMapScene::cancelOpen);
+        m_searchEdit->clear(); // 旧图的搜索结果作废
+        statusBar()->showMessage("正在打开: " + path);
+    });
+
+    connect(m_scene, &MindMapScene::openProgress, this, [this](int loaded) {
+        if (!m_openProgress) return;
+        m_openProgress->setLabelText(QString("已加载 %1 个节点").arg(loaded));
+        m_openProgress->setValue(0);
+    });
+
+    connect(m_scene, &MindMapScene::openFinished, this, [this](bool ok) {
+        if (m_openProgress) m_openProgress->deleteLater();
+        if (ok) {
+            m_packedAction->setChecked(m_scene->storageFormat() == MapStorage::PackedFormat);
+            statusBar()->showMessage("已打开思维导图: " + m_scene->mapPath(), 3000);
+        } else {
+            statusBar()->showMessage("打开已取消", 3000);
+        }
+    });
 }
 
 void MainWindow::createStatusBar()